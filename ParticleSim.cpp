@@ -0,0 +1,1066 @@
+#include "ParticleSim.hpp"
+#include <cstdlib>
+#include <sstream>
+static int scaledCount(int base, float density) {
+    return std::max(1, static_cast<int>(base * density));
+}
+ShapeParams defaultShapeParams() {
+    ShapeParams params;
+    params.sphereRadius = 120.0f;
+    params.cubeSize = 150.0f;
+    params.figure8Scale = 100.0f;
+    params.atomNucleusSize = 40.0f;
+    params.heartScale = 80.0f;
+    params.helixRadius = 100.0f;
+    params.density = 1.0f;
+    return params;
+}
+// sin/cos của camera tính một lần cho cả mảng thay vì mỗi hạt như rotatePoint
+struct CameraBasis {
+    float cx, sx, cy, sy, cz, sz;
+    float distance;
+    float scale;
+    explicit CameraBasis(const Camera& camera) :
+        cx(cos(camera.angleX)), sx(sin(camera.angleX)),
+        cy(cos(camera.angleY)), sy(sin(camera.angleY)),
+        cz(cos(camera.angleZ)), sz(sin(camera.angleZ)),
+        distance(camera.distance),
+        scale(camera.shapeScale)
+    {}
+};
+// Giống rotatePoint / inverseRotateDirection nhưng dùng sin/cos đã tính sẵn
+static inline sf::Vector3f rotateWithBasis(sf::Vector3f point, const CameraBasis& basis) {
+    point *= basis.scale;
+    float y1 = point.y * basis.cx - point.z * basis.sx;
+    float z1 = point.y * basis.sx + point.z * basis.cx;
+    float x2 = point.x * basis.cy + z1 * basis.sy;
+    float z2 = -point.x * basis.sy + z1 * basis.cy;
+    float x3 = x2 * basis.cz - y1 * basis.sz;
+    float y3 = x2 * basis.sz + y1 * basis.cz;
+    return sf::Vector3f(x3, y3, z2);
+}
+static inline sf::Vector3f inverseRotateWithBasis(sf::Vector3f dir, const CameraBasis& basis) {
+    float x2 = dir.x * basis.cz + dir.y * basis.sz;
+    float y1 = -dir.x * basis.sz + dir.y * basis.cz;
+    float x = x2 * basis.cy - dir.z * basis.sy;
+    float z1 = x2 * basis.sy + dir.z * basis.cy;
+    float y = y1 * basis.cx + z1 * basis.sx;
+    float z = -y1 * basis.sx + z1 * basis.cx;
+    return sf::Vector3f(x, y, z);
+}
+static inline bool isFinite(const sf::Vector3f& v) {
+    return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+}
+void SpatialHashGrid::build(const std::vector<sf::Vector3f>& positions, float size) {
+    int n = static_cast<int>(positions.size());
+    cellSize = size;
+    unsigned int tableSize = 1;
+    while (tableSize < static_cast<unsigned int>(n) * 2) tableSize <<= 1;
+    tableMask = tableSize - 1;
+    particleCell.resize(n);
+    sortedIndices.resize(n);
+    cellStart.assign(tableSize + 1, 0);
+    cellFill.resize(tableSize);
+    // Đếm số điểm mỗi ô (song song)
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        const sf::Vector3f& p = positions[i];
+        unsigned int h = hashCell(cellCoord(p.x), cellCoord(p.y), cellCoord(p.z));
+        particleCell[i] = h;
+        #pragma omp atomic
+        cellStart[h + 1]++;
+    }
+    // Prefix sum -> vị trí bắt đầu mỗi ô
+    for (unsigned int c = 0; c < tableSize; c++) {
+        cellStart[c + 1] += cellStart[c];
+    }
+    std::copy(cellStart.begin(), cellStart.end() - 1, cellFill.begin());
+    // Phân phối chỉ số vào ô (song song)
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        int slot;
+        #pragma omp atomic capture
+        slot = cellFill[particleCell[i]]++;
+        sortedIndices[slot] = i;
+    }
+}
+ParticleDynamics::ParticleDynamics() {
+    params.attraction = 12.0f;
+    params.damping = 3.0f;
+    params.mouseRadius = 120.0f;
+    params.mouseStrength = 2500.0f;
+    params.neighborRadius = 8.0f;
+    params.minNeighborRadius = 0.5f;
+    params.cellOccupancy = 2.0f;
+    params.maxNeighbors = 8;
+    params.maxCandidates = 16;
+    params.separationStrength = 60.0f;
+    params.alignmentStrength = 2.0f;
+    radius = params.neighborRadius;
+}
+void ParticleDynamics::step(std::vector<Particle3D>& particles, const Camera& camera, const Distortion& distortion,
+                            bool repelling, sf::Vector2f mouse, float time, float deltaTime) {
+    float dt = std::min(deltaTime, 1.0f / 30.0f); // Tránh nổ khi frame bị giật
+    bool distorting = fabs(distortion.amount) > 0.001f;
+    float mouseRadius2 = params.mouseRadius * params.mouseRadius;
+    CameraBasis basis(camera);
+    // Chọn hạt được mô phỏng cùng vị trí đích (generator có thể sinh tọa độ NaN, các hạt đó đứng yên)
+    active.clear();
+    positions.clear();
+    targets.clear();
+    for (int i = 0; i < static_cast<int>(particles.size()); i++) {
+        const Particle3D& p = particles[i];
+        if (p.isOrbiting) continue;
+        sf::Vector3f target = distorting ? applyDistortion(p.originalPosition, distortion, time) : p.originalPosition;
+        if (!isFinite(p.position) || !isFinite(target)) continue;
+        active.push_back(i);
+        positions.push_back(p.position);
+        targets.push_back(target);
+    }
+    int n = static_cast<int>(active.size());
+    radius = std::max(params.minNeighborRadius, std::min(params.neighborRadius, radius));
+    float radius2 = radius * radius;
+    grid.build(positions, 2.0f * radius);
+    // Chép dữ liệu theo thứ tự ô, đồng thời đếm số ô có hạt để chỉnh bán kính cho bước sau
+    sortedPosition.resize(n);
+    sortedTarget.resize(n);
+    sortedVelocity.resize(n);
+    accel.resize(n);
+    int occupiedCells = 0;
+    #pragma omp parallel for reduction(+:occupiedCells)
+    for (int k = 0; k < n; k++) {
+        int index = grid.sortedIndices[k];
+        sortedPosition[k] = positions[index];
+        sortedTarget[k] = targets[index];
+        sortedVelocity[k] = particles[active[index]].velocity;
+        if (k == 0 || grid.particleCell[index] != grid.particleCell[grid.sortedIndices[k - 1]]) occupiedCells++;
+    }
+    // Pass 1: tính gia tốc theo thứ tự ô (chỉ đọc mảng sorted nên song song an toàn)
+    int maxNeighbors = params.maxNeighbors;
+    int maxCandidates = params.maxCandidates;
+    #pragma omp parallel for schedule(dynamic, 512)
+    for (int k = 0; k < n; k++) {
+        sf::Vector3f position = sortedPosition[k];
+        sf::Vector3f target = sortedTarget[k];
+        sf::Vector3f a = (target - position) * params.attraction;
+        sf::Vector3f separation(0, 0, 0);
+        sf::Vector3f neighborVelocity(0, 0, 0);
+        int neighbors = 0;
+        int candidates = 0;
+        grid.forEachNeighbor(position, [&](int slot) -> bool {
+            if (slot == k) return true;
+            sf::Vector3f d = position - sortedPosition[slot];
+            float dist2 = d.x*d.x + d.y*d.y + d.z*d.z;
+            if (dist2 >= radius2) return ++candidates < maxCandidates;
+            sf::Vector3f rest = target - sortedTarget[slot];
+            float rest2 = rest.x*rest.x + rest.y*rest.y + rest.z*rest.z;
+            if (dist2 < rest2 && dist2 > 1e-6f) {
+                float dist = sqrt(dist2);
+                separation += d * ((std::sqrt(rest2) - dist) / dist);
+            }
+            neighborVelocity += sortedVelocity[slot];
+            return ++neighbors < maxNeighbors && ++candidates < maxCandidates;
+        });
+        if (neighbors > 0) {
+            float inv = 1.0f / neighbors;
+            a += separation * (params.separationStrength * inv);
+            a += (neighborVelocity * inv - sortedVelocity[k]) * params.alignmentStrength;
+        }
+        if (repelling) {
+            sf::Vector3f rotated = rotateWithBasis(position, basis);
+            float depth = rotated.z + basis.distance;
+            if (depth > 0) {
+                float scale = 400.0f / std::max(0.1f, depth);
+                sf::Vector2f d(rotated.x * scale + WIDTH / 2.0f - mouse.x, rotated.y * scale + HEIGHT / 2.0f - mouse.y);
+                float dist2 = d.x*d.x + d.y*d.y;
+                if (dist2 < mouseRadius2) {
+                    float dist = sqrt(dist2) + 0.001f;
+                    float falloff = 1.0f - dist / params.mouseRadius;
+                    sf::Vector3f push = inverseRotateWithBasis(sf::Vector3f(d.x / dist, d.y / dist, 0.0f), basis);
+                    a += push * (params.mouseStrength * falloff);
+                }
+            }
+        }
+        accel[k] = a;
+    }
+    // Pass 2: tích phân semi-implicit Euler
+    float damping = std::exp(-params.damping * dt);
+    #pragma omp parallel for
+    for (int k = 0; k < n; k++) {
+        Particle3D& p = particles[active[grid.sortedIndices[k]]];
+        p.velocity = (sortedVelocity[k] + accel[k] * dt) * damping;
+        p.position = sortedPosition[k] + p.velocity * dt;
+    }
+    // Ô đông hơn mong muốn -> thu nhỏ bán kính (hạt phân bố gần mặt nên số hạt mỗi ô ~ bán kính^2)
+    if (occupiedCells > 0) {
+        float occupancy = static_cast<float>(n) / occupiedCells;
+        float factor = sqrt(params.cellOccupancy / occupancy);
+        radius *= std::max(0.7f, std::min(1.25f, factor));
+    }
+}
+void ParticleDynamics::reset(std::vector<Particle3D>& particles) const {
+    for (auto& p : particles) {
+        if (!p.isOrbiting) {
+            p.position = p.originalPosition;
+            p.velocity = sf::Vector3f(0, 0, 0);
+        }
+    }
+}
+QualityGovernor::QualityGovernor() :
+    level(LEVELS - 1),
+    locked(false),
+    targetFrameTime(1.0f / 60.0f),
+    smoothedTime(0.0f),
+    overBudgetTime(0.0f),
+    underBudgetTime(0.0f),
+    cooldown(0.0f),
+    upgradeHoldTime(2.0f),
+    sinceUpgrade(1000.0f)
+{}
+QualitySettings QualityGovernor::settings() const {
+    static const QualitySettings table[LEVELS] = {
+        // fraction, lod, trailLength, trailSampling, glow
+        { 0.35f, 100.0f, 0.25f, 0.0f,  false },
+        { 0.6f,  4.0f,   0.4f,  0.25f, false },
+        { 1.0f,  2.5f,   0.6f,  0.5f,  false },
+        { 1.0f,  1.0f,   1.0f,  1.0f,  false },
+        { 1.0f,  0.0f,   1.0f,  1.0f,  true  }
+    };
+    return table[level];
+}
+void QualityGovernor::setLevel(int newLevel) {
+    level = std::max(0, std::min(LEVELS - 1, newLevel));
+    overBudgetTime = 0.0f;
+    underBudgetTime = 0.0f;
+}
+void QualityGovernor::record(float stageTime, float deltaTime) {
+    smoothedTime += (stageTime - smoothedTime) * 0.1f;
+    if (locked) return;
+    sinceUpgrade += deltaTime;
+    cooldown = std::max(0.0f, cooldown - deltaTime);
+    if (smoothedTime > targetFrameTime * 0.9f) {
+        overBudgetTime += deltaTime;
+        underBudgetTime = 0.0f;
+    } else if (smoothedTime < targetFrameTime * 0.5f) {
+        underBudgetTime += deltaTime;
+        overBudgetTime = 0.0f;
+    } else {
+        overBudgetTime = 0.0f;
+        underBudgetTime = 0.0f;
+    }
+    if (cooldown > 0.0f) return;
+    if (overBudgetTime > 0.5f && level > 0) {
+        // Vừa nâng đã quá tải -> lần sau chờ lâu hơn
+        if (sinceUpgrade < 3.0f) upgradeHoldTime = std::min(30.0f, upgradeHoldTime * 2.0f);
+        setLevel(level - 1);
+        cooldown = 1.0f;
+    } else if (underBudgetTime > upgradeHoldTime && level < LEVELS - 1) {
+        setLevel(level + 1);
+        cooldown = 1.0f;
+        sinceUpgrade = 0.0f;
+    }
+}
+sf::Color hslToColor(float h, float s, float l) {
+    h = fmod(h, 360.0f);
+    float c = (1.0f - fabs(2.0f * l - 1.0f)) * s;
+    float x = c * (1.0f - fabs(fmod(h / 60.0f, 2.0f) - 1.0f));
+    float m = l - c / 2.0f;
+    float r, g, b;
+    if (h < 60) { r = c; g = x; b = 0; }
+    else if (h < 120) { r = x; g = c; b = 0; }
+    else if (h < 180) { r = 0; g = c; b = x; }
+    else if (h < 240) { r = 0; g = x; b = c; }
+    else if (h < 300) { r = x; g = 0; b = c; }
+    else { r = c; g = 0; b = x; }
+    return sf::Color(
+        static_cast<sf::Uint8>((r + m) * 255),
+        static_cast<sf::Uint8>((g + m) * 255),
+        static_cast<sf::Uint8>((b + m) * 255),
+        220
+    );
+}
+sf::Vector3f rotatePoint(sf::Vector3f point, const Camera& camera) {
+    point *= camera.shapeScale;
+    float y1 = point.y * cos(camera.angleX) - point.z * sin(camera.angleX);
+    float z1 = point.y * sin(camera.angleX) + point.z * cos(camera.angleX);
+    float x2 = point.x * cos(camera.angleY) + z1 * sin(camera.angleY);
+    float z2 = -point.x * sin(camera.angleY) + z1 * cos(camera.angleY);
+    float x3 = x2 * cos(camera.angleZ) - y1 * sin(camera.angleZ);
+    float y3 = x2 * sin(camera.angleZ) + y1 * cos(camera.angleZ);
+    return sf::Vector3f(x3, y3, z2);
+}
+sf::Vector2f projectPoint(sf::Vector3f point, const Camera& camera) {
+    float fov = 400.0f; // Fixed fov, cameraDistance affects position
+    float z = point.z + camera.distance;
+    if (z < 0.1f) z = 0.1f;
+    float scale = fov / z;
+    float x = point.x * scale + WIDTH / 2.0f;
+    float y = point.y * scale + HEIGHT / 2.0f;
+    return sf::Vector2f(x, y);
+}
+sf::Vector3f inverseRotateDirection(sf::Vector3f dir, const Camera& camera) {
+    float x2 = dir.x * cos(camera.angleZ) + dir.y * sin(camera.angleZ);
+    float y1 = -dir.x * sin(camera.angleZ) + dir.y * cos(camera.angleZ);
+    float x = x2 * cos(camera.angleY) - dir.z * sin(camera.angleY);
+    float z1 = x2 * sin(camera.angleY) + dir.z * cos(camera.angleY);
+    float y = y1 * cos(camera.angleX) + z1 * sin(camera.angleX);
+    float z = -y1 * sin(camera.angleX) + z1 * cos(camera.angleX);
+    return sf::Vector3f(x, y, z);
+}
+// Xoay + chiếu một điểm (trước scale camera); trả về false nếu nằm ngoài khoảng độ sâu vẽ được
+static inline bool projectToScreen(sf::Vector3f point, float size, sf::Color color,
+                                   const CameraBasis& basis, ProjectedParticle& out) {
+    sf::Vector3f rotated = rotateWithBasis(point, basis);
+    float depth = rotated.z + basis.distance;
+    out.depth = depth;
+    if (!(depth > 0 && depth < 2000.0f)) return false;
+    float screenScale = 400.0f / std::max(0.1f, depth);
+    out.screen = sf::Vector2f(rotated.x * screenScale + WIDTH / 2.0f, rotated.y * screenScale + HEIGHT / 2.0f);
+    float projScale = 400.0f / depth; // Scale size with distance for perspective
+    out.size = std::max(0.5f, std::min(10.0f, size * projScale));
+    out.color = color;
+    float depthFactor = 1.0f - (depth / 2000.0f); // Adjusted for farther fade
+    out.color.a = static_cast<sf::Uint8>(color.a * (0.4f + 0.6f * depthFactor));
+    // Ô picking tính luôn ở đây để ScreenBinGrid không phải đọc lại vị trí
+    bool onScreen = out.screen.x >= 0 && out.screen.x < WIDTH && out.screen.y >= 0 && out.screen.y < HEIGHT;
+    out.bin = onScreen ? static_cast<int>(out.screen.y) / SCREEN_BIN_SIZE * SCREEN_BIN_COLUMNS +
+                         static_cast<int>(out.screen.x) / SCREEN_BIN_SIZE : -1;
+    return true;
+}
+// Hạt i được giữ nếu phần nguyên của (i+1)*fraction tăng - tương đương bộ tích lũy tuần tự
+static inline bool keepParticle(int i, float visibleFraction) {
+    return visibleFraction >= 1.0f ||
+        static_cast<int>((i + 1) * visibleFraction) > static_cast<int>(i * visibleFraction);
+}
+void projectParticles(const std::vector<Particle3D>& particles, const Camera& camera,
+                      float visibleFraction, std::vector<ProjectedParticle>& projected) {
+    int n = static_cast<int>(particles.size());
+    projected.resize(n);
+    CameraBasis basis(camera);
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        const Particle3D& p = particles[i];
+        ProjectedParticle& out = projected[i];
+        out.visible = keepParticle(i, visibleFraction) &&
+            projectToScreen(p.position, p.size, p.color, basis, out);
+    }
+}
+void ScreenBinGrid::build(const std::vector<ProjectedParticle>& projected) {
+    int n = static_cast<int>(projected.size());
+    int binCount = SCREEN_BIN_COLUMNS * SCREEN_BIN_ROWS;
+    binStart.assign(binCount + 1, 0);
+    binFill.resize(binCount);
+    // Đếm số hạt mỗi ô (song song)
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        if (!projected[i].visible || projected[i].bin < 0) continue;
+        #pragma omp atomic
+        binStart[projected[i].bin + 1]++;
+    }
+    for (int b = 0; b < binCount; b++) {
+        binStart[b + 1] += binStart[b];
+    }
+    entries.resize(binStart[binCount]);
+    std::copy(binStart.begin(), binStart.end() - 1, binFill.begin());
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        if (!projected[i].visible || projected[i].bin < 0) continue;
+        int slot;
+        #pragma omp atomic capture
+        slot = binFill[projected[i].bin]++;
+        entries[slot] = i;
+    }
+    // ID buffer: mỗi bin sở hữu riêng các ô pick của nó nên các bin điền song song không tranh chấp
+    // Chỉ bin có hạt ở lần build trước hoặc lần này mới cần xóa / điền lại
+    const int cellsPerBin = SCREEN_BIN_SIZE / SCREEN_PICK_CELL_SIZE;
+    pickCell.resize(SCREEN_PICK_COLUMNS * SCREEN_PICK_ROWS, -1);
+    binFilled.resize(binCount, 0);
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int b = 0; b < binCount; b++) {
+        bool occupied = binStart[b + 1] > binStart[b];
+        if (!occupied && !binFilled[b]) continue;
+        binFilled[b] = occupied;
+        int firstColumn = b % SCREEN_BIN_COLUMNS * cellsPerBin;
+        int firstRow = b / SCREEN_BIN_COLUMNS * cellsPerBin;
+        for (int r = 0; r < cellsPerBin; r++) {
+            std::fill_n(pickCell.begin() + (firstRow + r) * SCREEN_PICK_COLUMNS + firstColumn, cellsPerBin, -1);
+        }
+        for (int k = binStart[b]; k < binStart[b + 1]; k++) {
+            const ProjectedParticle& p = projected[entries[k]];
+            int cell = static_cast<int>(p.screen.y) / SCREEN_PICK_CELL_SIZE * SCREEN_PICK_COLUMNS +
+                       static_cast<int>(p.screen.x) / SCREEN_PICK_CELL_SIZE;
+            int current = pickCell[cell];
+            if (current < 0 || p.depth < projected[current].depth) pickCell[cell] = entries[k];
+        }
+    }
+}
+void ScreenBinGrid::clear() {
+    binStart.clear();
+    entries.clear();
+    pickCell.clear();
+    binFilled.clear();
+}
+int ScreenBinGrid::nearest(sf::Vector2f point, float maxDistance, const std::vector<ProjectedParticle>& projected) const {
+    if (pickCell.empty()) return -1;
+    int minCol = std::max(0, static_cast<int>(std::floor((point.x - maxDistance) / SCREEN_PICK_CELL_SIZE)));
+    int maxCol = std::min(SCREEN_PICK_COLUMNS - 1, static_cast<int>(std::floor((point.x + maxDistance) / SCREEN_PICK_CELL_SIZE)));
+    int minRow = std::max(0, static_cast<int>(std::floor((point.y - maxDistance) / SCREEN_PICK_CELL_SIZE)));
+    int maxRow = std::min(SCREEN_PICK_ROWS - 1, static_cast<int>(std::floor((point.y + maxDistance) / SCREEN_PICK_CELL_SIZE)));
+    int best = -1;
+    float bestDist2 = maxDistance * maxDistance;
+    float bestDepth = 0.0f;
+    const int cellsPerBin = SCREEN_BIN_SIZE / SCREEN_PICK_CELL_SIZE;
+    for (int row = minRow; row <= maxRow; row++) {
+        for (int col = minCol; col <= maxCol; col++) {
+            int bin = row / cellsPerBin * SCREEN_BIN_COLUMNS + col / cellsPerBin;
+            if (binStart[bin] == binStart[bin + 1]) {
+                col = (col / cellsPerBin + 1) * cellsPerBin - 1; // Bin rỗng: nhảy qua phần còn lại của bin trên hàng này
+                continue;
+            }
+            int index = pickCell[row * SCREEN_PICK_COLUMNS + col];
+            if (index < 0) continue;
+            const ProjectedParticle& p = projected[index];
+            float dx = p.screen.x - point.x;
+            float dy = p.screen.y - point.y;
+            float dist2 = dx*dx + dy*dy;
+            // Cùng khoảng cách thì ưu tiên hạt gần camera hơn
+            if (dist2 < bestDist2 || (dist2 == bestDist2 && best >= 0 && p.depth < bestDepth)) {
+                best = index;
+                bestDist2 = dist2;
+                bestDepth = p.depth;
+            }
+        }
+    }
+    return best;
+}
+void ScreenBinGrid::selectBox(const sf::FloatRect& box, const std::vector<ProjectedParticle>& projected, std::vector<int>& out) const {
+    if (binStart.empty()) return;
+    float right = box.left + box.width;
+    float bottom = box.top + box.height;
+    int minCol = std::max(0, static_cast<int>(std::floor(box.left / SCREEN_BIN_SIZE)));
+    int maxCol = std::min(SCREEN_BIN_COLUMNS - 1, static_cast<int>(std::floor(right / SCREEN_BIN_SIZE)));
+    int minRow = std::max(0, static_cast<int>(std::floor(box.top / SCREEN_BIN_SIZE)));
+    int maxRow = std::min(SCREEN_BIN_ROWS - 1, static_cast<int>(std::floor(bottom / SCREEN_BIN_SIZE)));
+    for (int row = minRow; row <= maxRow; row++) {
+        for (int col = minCol; col <= maxCol; col++) {
+            int bin = row * SCREEN_BIN_COLUMNS + col;
+            // Ô nằm trọn trong box thì lấy hết, không cần kiểm tra từng hạt
+            bool inside = col * SCREEN_BIN_SIZE >= box.left && (col + 1) * SCREEN_BIN_SIZE <= right &&
+                          row * SCREEN_BIN_SIZE >= box.top && (row + 1) * SCREEN_BIN_SIZE <= bottom;
+            for (int k = binStart[bin]; k < binStart[bin + 1]; k++) {
+                const ProjectedParticle& p = projected[entries[k]];
+                if (inside || (p.screen.x >= box.left && p.screen.x <= right &&
+                               p.screen.y >= box.top && p.screen.y <= bottom)) {
+                    out.push_back(entries[k]);
+                }
+            }
+        }
+    }
+}
+void projectParticleSubset(const std::vector<Particle3D>& particles, const std::vector<int>& indices,
+                           const Camera& camera, float visibleFraction, std::vector<ProjectedParticle>& projected) {
+    int n = static_cast<int>(indices.size());
+    projected.resize(n);
+    CameraBasis basis(camera);
+    for (int k = 0; k < n; k++) {
+        int i = indices[k];
+        const Particle3D& p = particles[i];
+        projected[k].visible = keepParticle(i, visibleFraction) &&
+            projectToScreen(p.position, p.size, p.color, basis, projected[k]);
+    }
+}
+PointCloudPtr PointCloudCache::get(ShapeType shape, const ShapeParams& params, float shapeScale,
+                                   float hueOffset, float time) {
+    if (!cloud || this->shape != shape || this->shapeScale != shapeScale || density != params.density) {
+        cloud.reset(); // Thả cloud cũ trước khi sinh để không giữ hai cloud cùng lúc
+        std::shared_ptr<PointCloud> generated(new PointCloud());
+        generateShape(shape, *generated, params, shapeScale, hueOffset, time);
+        cloud = generated;
+        this->shape = shape;
+        this->shapeScale = shapeScale;
+        density = params.density;
+    }
+    return cloud;
+}
+void PointCloudCache::clear() {
+    cloud.reset();
+}
+void projectInstances(const std::vector<ShapeInstance>& instances, size_t first, size_t count,
+                      const Camera& camera, float visibleFraction, float time,
+                      std::vector<ProjectedParticle>& projected) {
+    size_t last = std::min(instances.size(), first + count);
+    size_t total = 0;
+    for (size_t k = first; k < last; k++) {
+        total += instances[k].cloud->size();
+    }
+    projected.resize(total);
+    CameraBasis basis(camera);
+    size_t base = 0;
+    for (size_t k = first; k < last; k++) {
+        const ShapeInstance& instance = instances[k];
+        const PointCloud& cloud = *instance.cloud;
+        // Transform riêng của instance: scale, quay quanh trục Y theo pha, rồi dời tới offset
+        float spin = instance.phase + time * instance.spinSpeed;
+        float cs = cos(spin), sn = sin(spin);
+        int n = static_cast<int>(cloud.size());
+        ProjectedParticle* out = &projected[base];
+        #pragma omp parallel for
+        for (int i = 0; i < n; i++) {
+            const Particle3D& p = cloud[i];
+            if (!keepParticle(i, visibleFraction)) {
+                out[i].visible = false;
+                continue;
+            }
+            sf::Vector3f local = p.position * instance.scale;
+            sf::Vector3f world(local.x * cs + local.z * sn + instance.offset.x,
+                               local.y + instance.offset.y,
+                               -local.x * sn + local.z * cs + instance.offset.z);
+            sf::Color color(
+                static_cast<sf::Uint8>(p.color.r * instance.tint.r / 255),
+                static_cast<sf::Uint8>(p.color.g * instance.tint.g / 255),
+                static_cast<sf::Uint8>(p.color.b * instance.tint.b / 255),
+                static_cast<sf::Uint8>(p.color.a * instance.tint.a / 255));
+            out[i].visible = projectToScreen(world, p.size * instance.scale, color, basis, out[i]);
+        }
+        base += n;
+    }
+}
+// Hàm tạo hình cầu 3D RỖNG (hollow) - Cải thiện: Thêm nhiều lớp hơn, màu sắc gradient mượt mà hơn, thêm hiệu ứng glow
+void generateSphere3D(std::vector<Particle3D>& particles, const ShapeParams& params, float shapeScale, float hueOffset, float time) {
+    particles.clear();
+    int numLayers = 12; // Tăng số lớp cho độ mịn hơn
+    int particlesPerLayer = scaledCount(300, params.density); // Tăng số hạt mỗi lớp
+    for (int layer = 0; layer < numLayers; layer++) {
+        float radiusRatio = 0.2f + (layer / (float)numLayers) * 0.8f;
+        float currentRadius = params.sphereRadius * radiusRatio;
+        for (int i = 0; i < particlesPerLayer; i++) {
+            Particle3D p;
+            float phi = acos(1.0f - 2.0f * (i + 0.5f) / particlesPerLayer);
+            float theta = PI * (1.0f + sqrt(5.0f)) * i;
+            p.position.x = currentRadius * sin(phi) * cos(theta);
+            p.position.y = currentRadius * sin(phi) * sin(theta);
+            p.position.z = currentRadius * cos(phi);
+            p.originalPosition = p.position;
+            p.size = 2.0f + 1.0f * sin(theta * 4.0f); // Variation kích thước
+            p.velocity = sf::Vector3f(0, 0, 0);
+            float hue = (layer * 30.0f + hueOffset) + sin(theta) * 10.0f; // Thêm variation hue
+            float saturation = 0.85f + 0.15f * cos(phi);
+            float lightness = 0.5f + 0.3f * sin(layer * 1.5f);
+            p.color = hslToColor(hue, saturation, lightness);
+            p.color.a = 160 + 80 * (layer % 2); // Xen kẽ alpha
+            p.isOrbiting = false;
+            p.layer = layer;
+            particles.push_back(p);
+        }
+    }
+    // Tăng connections cho lưới dày hơn
+    int connections = scaledCount(800, params.density);
+    for (int i = 0; i < connections; i++) {
+        Particle3D p;
+        float t = (rand() % 1000) / 1000.0f;
+        int layer1 = rand() % numLayers;
+        int layer2 = (layer1 + 1 + rand() % 2) % numLayers; // Kết nối xa hơn
+        float r1 = params.sphereRadius * (0.2f + (layer1 / (float)numLayers) * 0.8f);
+        float r2 = params.sphereRadius * (0.2f + (layer2 / (float)numLayers) * 0.8f);
+        float phi = acos(1.0f - 2.0f * t);
+        float theta = 2.0f * PI * t * 12.0f;
+        float currentRadius = r1 * (1.0f - t) + r2 * t;
+        p.position.x = currentRadius * sin(phi) * cos(theta);
+        p.position.y = currentRadius * sin(phi) * sin(theta);
+        p.position.z = currentRadius * cos(phi);
+        p.originalPosition = p.position;
+        p.size = 1.0f + 0.5f * sin(i * 0.1f);
+        p.velocity = sf::Vector3f(0, 0, 0);
+        p.color = sf::Color(200, 255, 255, 80 + rand() % 40); // Màu cyan mờ variation
+        p.isOrbiting = false;
+        p.layer = numLayers;
+        particles.push_back(p);
+    }
+}
+// Hình hộp rỗng 3D - Cải thiện: Thêm hạt ở mặt để tạo cảm giác khối hơn, màu sắc đa dạng hơn
+void generateHollowCube(std::vector<Particle3D>& particles, const ShapeParams& params, float shapeScale, float hueOffset, float time) {
+    particles.clear();
+    int particlesPerEdge = scaledCount(50, params.density); // Tăng số hạt
+    float size = params.cubeSize * shapeScale;
+    // 12 cạnh
+    for (int edge = 0; edge < 12; edge++) {
+        for (int i = 0; i < particlesPerEdge; i++) {
+            Particle3D p;
+            float t = static_cast<float>(i) / particlesPerEdge;
+            switch(edge) {
+                case 0: p.position = sf::Vector3f(-size, -size, -size) * (1.0f - t) + sf::Vector3f(size, -size, -size) * t; break;
+                case 1: p.position = sf::Vector3f(size, -size, -size) * (1.0f - t) + sf::Vector3f(size, size, -size) * t; break;
+                case 2: p.position = sf::Vector3f(size, size, -size) * (1.0f - t) + sf::Vector3f(-size, size, -size) * t; break;
+                case 3: p.position = sf::Vector3f(-size, size, -size) * (1.0f - t) + sf::Vector3f(-size, -size, -size) * t; break;
+                case 4: p.position = sf::Vector3f(-size, -size, size) * (1.0f - t) + sf::Vector3f(size, -size, size) * t; break;
+                case 5: p.position = sf::Vector3f(size, -size, size) * (1.0f - t) + sf::Vector3f(size, size, size) * t; break;
+                case 6: p.position = sf::Vector3f(size, size, size) * (1.0f - t) + sf::Vector3f(-size, size, size) * t; break;
+                case 7: p.position = sf::Vector3f(-size, size, size) * (1.0f - t) + sf::Vector3f(-size, -size, size) * t; break;
+                case 8: p.position = sf::Vector3f(-size, -size, -size) * (1.0f - t) + sf::Vector3f(-size, -size, size) * t; break;
+                case 9: p.position = sf::Vector3f(size, -size, -size) * (1.0f - t) + sf::Vector3f(size, -size, size) * t; break;
+                case 10: p.position = sf::Vector3f(size, size, -size) * (1.0f - t) + sf::Vector3f(size, size, size) * t; break;
+                case 11: p.position = sf::Vector3f(-size, size, -size) * (1.0f - t) + sf::Vector3f(-size, size, size) * t; break;
+            }
+            p.originalPosition = p.position;
+            p.size = 2.0f + 0.5f * sin(t * PI * 4); // Variation size
+            p.velocity = sf::Vector3f(0, 0, 0);
+            float hue = (edge * 30.0f + hueOffset);
+            p.color = hslToColor(hue, 0.8f, 0.6f);
+            p.color.a = 220;
+            p.isOrbiting = false;
+            p.layer = edge;
+            particles.push_back(p);
+        }
+    }
+    // Thêm hạt ở mặt để tạo khối (mờ hơn)
+    int faceParticles = scaledCount(100, params.density); // Per face
+    for (int face = 0; face < 6; face++) {
+        for (int i = 0; i < faceParticles; i++) {
+            Particle3D p;
+            float u = (rand() % 1000) / 1000.0f;
+            float v = (rand() % 1000) / 1000.0f;
+            switch(face) {
+                case 0: p.position = sf::Vector3f(size * (2*u-1), size * (2*v-1), -size); break; // Front
+                case 1: p.position = sf::Vector3f(size * (2*u-1), size * (2*v-1), size); break; // Back
+                case 2: p.position = sf::Vector3f(size * (2*u-1), -size, size * (2*v-1)); break; // Bottom
+                case 3: p.position = sf::Vector3f(size * (2*u-1), size, size * (2*v-1)); break; // Top
+                case 4: p.position = sf::Vector3f(-size, size * (2*u-1), size * (2*v-1)); break; // Left
+                case 5: p.position = sf::Vector3f(size, size * (2*u-1), size * (2*v-1)); break; // Right
+            }
+            p.originalPosition = p.position;
+            p.size = 1.5f;
+            p.velocity = sf::Vector3f(0, 0, 0);
+            p.color = hslToColor(face * 60.0f + hueOffset, 0.7f, 0.5f);
+            p.color.a = 80; // Mờ để không che cạnh
+            p.isOrbiting = false;
+            p.layer = 12 + face;
+            particles.push_back(p);
+        }
+    }
+}
+// Hình số 8 xoắn 3D DẠNG KHỐI - Cải thiện: Tăng slices, thêm variation thickness, màu rainbow
+void generateFigure8Spiral(std::vector<Particle3D>& particles, const ShapeParams& params, float shapeScale, float hueOffset, float time) {
+    particles.clear();
+    int numSlices = 15; // Tăng slices
+    int particlesPerSlice = scaledCount(250, params.density);
+    for (int slice = 0; slice < numSlices; slice++) {
+        float zOffset = (slice - numSlices/2.0f) * 12.0f;
+        for (int i = 0; i < particlesPerSlice; i++) {
+            Particle3D p;
+            float t = static_cast<float>(i) / particlesPerSlice * 4.0f * PI;
+            float scale = params.figure8Scale * shapeScale;
+            float a = scale * sqrt(2.0f * cos(2.0f * t) + 0.1f * sin(t * 3)); // Variation a
+            float x = a * cos(t);
+            float y = a * sin(t);
+            float z = zOffset + scale * 0.15f * sin(t * 4.0f + time);
+            float thickness = 6.0f + 2.0f * sin(slice * PI / numSlices);
+            float offsetAngle = t * 3.0f + slice * 0.2f;
+            float offsetX = thickness * cos(offsetAngle);
+            float offsetY = thickness * sin(offsetAngle);
+            p.position = sf::Vector3f(x + offsetX, y + offsetY, z);
+            p.originalPosition = p.position;
+            p.size = 1.8f + 1.2f * sin(t * 6.0f + slice * 0.6f);
+            p.velocity = sf::Vector3f(0, 0, 0);
+            float hue = (t * 90.0f + slice * 20.0f + hueOffset);
+            p.color = hslToColor(hue, 0.95f, 0.65f);
+            p.color.a = 190 - slice * 8;
+            p.isOrbiting = false;
+            p.layer = slice;
+            particles.push_back(p);
+        }
+    }
+    // Tăng connections
+    int connections = scaledCount(500, params.density);
+    for (int i = 0; i < connections; i++) {
+        Particle3D p;
+        float t = (rand() % 1000) / 1000.0f * 4.0f * PI;
+        int slice1 = rand() % numSlices;
+        int slice2 = (slice1 + 1 + rand() % 3) % numSlices;
+        float scale = params.figure8Scale * shapeScale;
+        float a = scale * sqrt(2.0f * cos(2.0f * t));
+        float x = a * cos(t);
+        float y = a * sin(t);
+        float z1 = (slice1 - numSlices/2.0f) * 12.0f;
+        float z2 = (slice2 - numSlices/2.0f) * 12.0f;
+        float interp = (rand() % 1000) / 1000.0f;
+        float z = z1 * (1.0f - interp) + z2 * interp;
+        p.position = sf::Vector3f(x, y, z);
+        p.originalPosition = p.position;
+        p.size = 1.0f;
+        p.velocity = sf::Vector3f(0, 0, 0);
+        p.color = sf::Color(255, 255, 200, 60 + rand() % 40);
+        p.isOrbiting = false;
+        p.layer = numSlices;
+        particles.push_back(p);
+    }
+}
+// Mô hình nguyên tử - Cải thiện: Thêm nhiều orbit hơn, variation nucleus, trails dài hơn
+void generateAtomicModel(std::vector<Particle3D>& particles, const ShapeParams& params, float shapeScale, float hueOffset, float time) {
+    particles.clear();
+    // Hạt nhân
+    int nucleusParticles = scaledCount(300, params.density); // Tăng
+    float nucleusSize = params.atomNucleusSize * shapeScale;
+    for (int i = 0; i < nucleusParticles; i++) {
+        Particle3D p;
+        float phi = acos(1.0f - 2.0f * (i + 0.5f) / nucleusParticles);
+        float theta = PI * (1.0f + sqrt(5.0f)) * i;
+        float r = nucleusSize * (0.6f + 0.4f * sin(time + theta * 2.0f));
+        p.position.x = r * sin(phi) * cos(theta);
+        p.position.y = r * sin(phi) * sin(theta);
+        p.position.z = r * cos(phi);
+        p.originalPosition = p.position;
+        p.size = 2.0f + 1.5f * sin(theta * 6.0f + time);
+        p.velocity = sf::Vector3f(0, 0, 0);
+        float hue = 0.0f + 30.0f * sin(theta);
+        p.color = hslToColor(hue, 0.9f, 0.6f);
+        p.color.a = 240;
+        p.isOrbiting = false;
+        p.layer = 0;
+        particles.push_back(p);
+    }
+    // Orbits
+    int orbits = 4; // Tăng
+    int electronsPerOrbit = 10;
+    float orbitSpeeds[] = {1.2f, 0.8f, 0.5f, 0.3f};
+    float orbitRadii[] = {200.0f, 140.0f, 100.0f, 60.0f};
+    sf::Color orbitColors[] = {
+        sf::Color(80, 180, 255, 210),
+        sf::Color(80, 255, 180, 210),
+        sf::Color(255, 180, 80, 210),
+        sf::Color(180, 80, 255, 210)
+    };
+    for (int orbit = 0; orbit < orbits; orbit++) {
+        for (int i = 0; i < electronsPerOrbit; i++) {
+            Particle3D p;
+            float angle = static_cast<float>(i) / electronsPerOrbit * 2.0f * PI + time * orbitSpeeds[orbit];
+            float radius = orbitRadii[orbit] * shapeScale;
+            float tilt = orbit * 0.3f; // Tilt different orbits
+            float x = radius * cos(angle);
+            float y = radius * sin(angle) * cos(tilt);
+            float z = radius * sin(angle) * sin(tilt);
+            p.position = sf::Vector3f(x, y, z);
+            p.originalPosition = p.position;
+            p.size = 2.5f + 0.5f * orbit;
+            p.velocity = sf::Vector3f(0, 0, 0);
+            p.color = orbitColors[orbit];
+            p.isOrbiting = true;
+            p.orbitCenter = sf::Vector3f(0, 0, 0);
+            p.orbitRadius = radius;
+            p.orbitAngle = angle;
+            p.orbitSpeed = orbitSpeeds[orbit];
+            p.layer = 1 + orbit;
+            particles.push_back(p);
+        }
+    }
+}
+// Hình trái tim 3D DẠNG KHỐI - Cải thiện: Tăng layers, inner particles dày hơn, màu gradient mượt
+void generateHeart3D(std::vector<Particle3D>& particles, const ShapeParams& params, float shapeScale, float hueOffset, float time) {
+    particles.clear();
+    int numLayers = 12; // Tăng
+    int particlesPerLayer = scaledCount(400, params.density);
+    for (int layer = 0; layer < numLayers; layer++) {
+        float layerFactor = (layer - numLayers/2.0f) / (numLayers/2.0f);
+        for (int i = 0; i < particlesPerLayer; i++) {
+            Particle3D p;
+            float u = static_cast<float>(i) / particlesPerLayer * 2.0f * PI;
+            float scale = params.heartScale * shapeScale;
+            float x = 16.0f * pow(sin(u), 3);
+            float y = 13.0f * cos(u) - 5.0f * cos(2.0f * u) - 2.0f * cos(3.0f * u) - cos(4.0f * u);
+            float thickness = 8.0f * layerFactor * (0.7f + 0.3f * cos(layer * 3.0f));
+            p.position = sf::Vector3f(
+                x * scale * 0.08f + 2.0f * sin(u * 5.0f),
+                -y * scale * 0.08f + 2.0f * cos(u * 5.0f),
+                thickness * (0.6f + 0.4f * sin(u * 3.0f))
+            );
+            p.originalPosition = p.position;
+            p.size = 1.8f + 1.0f * sin(u * 8.0f + layer * 0.5f);
+            p.velocity = sf::Vector3f(0, 0, 0);
+            float redIntensity = 0.6f + 0.4f * (1.0f - fabs(layerFactor));
+            float pinkFactor = fabs(layerFactor) * 0.6f;
+            float hue = 330.0f + 30.0f * layerFactor;
+            p.color = hslToColor(hue, 0.8f, redIntensity * 0.5f + pinkFactor * 0.5f);
+            p.color.a = 170 + 80 * (layer % 2);
+            p.isOrbiting = false;
+            p.layer = layer;
+            particles.push_back(p);
+        }
+    }
+    // Inner particles dày hơn
+    int innerParticles = scaledCount(800, params.density);
+    for (int i = 0; i < innerParticles; i++) {
+        Particle3D p;
+        float r = (rand() % 1000) / 1000.0f;
+        float theta = (rand() % 1000) / 1000.0f * 2.0f * PI;
+        float phi = (rand() % 1000) / 1000.0f * PI;
+        float scale = params.heartScale * shapeScale * 0.6f;
+        p.position.x = scale * r * sin(phi) * cos(theta) * 0.4f;
+        p.position.y = scale * r * sin(phi) * sin(theta) * 0.4f;
+        p.position.z = scale * r * cos(phi) * 0.25f;
+        float heartX = p.position.x / (scale * 0.08f);
+        float heartY = -p.position.y / (scale * 0.08f);
+        float heartVal = pow(heartX*heartX + heartY*heartY - 1, 3) - heartX*heartX * heartY*heartY*heartY;
+        if (heartVal < 0.15f) { // Mở rộng vùng
+            p.originalPosition = p.position;
+            p.size = 1.2f + 0.8f * sin(i * 0.05f);
+            p.velocity = sf::Vector3f(0, 0, 0);
+            p.color = hslToColor(340.0f + rand() % 20, 0.7f, 0.6f);
+            p.color.a = 100 + rand() % 40;
+            p.isOrbiting = false;
+            p.layer = numLayers;
+            particles.push_back(p);
+        }
+    }
+}
+// Xoắn kép (DNA-like) - Cải thiện: Thêm bonds giữa strands, variation radius, màu gradient
+void generateDoubleHelix(std::vector<Particle3D>& particles, const ShapeParams& params, float shapeScale, float hueOffset, float time) {
+    particles.clear();
+    int numParticles = scaledCount(1200, params.density); // Tăng
+    float radius = params.helixRadius * shapeScale;
+    float height = 350.0f * shapeScale;
+    for (int i = 0; i < numParticles; i++) {
+        float t = static_cast<float>(i) / numParticles;
+        float z = height * (t - 0.5f);
+        for (int strand = 0; strand < 2; strand++) {
+            Particle3D p;
+            float angle = t * 10.0f * PI + (strand * PI) + sin(t * PI) * 0.5f; // Variation angle
+            float localRadius = radius * (0.8f + 0.2f * sin(t * 6.0f * PI));
+            float x = localRadius * cos(angle);
+            float y = localRadius * sin(angle);
+            p.position = sf::Vector3f(x, y, z);
+            p.originalPosition = p.position;
+            p.size = 2.5f + 0.5f * cos(t * PI * 10);
+            p.velocity = sf::Vector3f(0, 0, 0);
+            float hue = (strand == 0 ? 0.0f : 240.0f) + t * 60.0f + hueOffset;
+            p.color = hslToColor(hue, 0.9f, 0.7f);
+            p.color.a = 230;
+            p.isOrbiting = false;
+            p.layer = strand;
+            particles.push_back(p);
+        }
+    }
+    // Thêm bonds giữa strands
+    int bonds = numParticles / 2;
+    for (int i = 0; i < bonds; i++) {
+        float t = static_cast<float>(i) / bonds;
+        float z = height * (t - 0.5f);
+        float angle = t * 10.0f * PI;
+        sf::Vector3f pos1(radius * cos(angle), radius * sin(angle), z);
+        sf::Vector3f pos2 = pos1 * -1.0f; // Opposite
+        int numBondParticles = 10;
+        for (int j = 0; j < numBondParticles; j++) {
+            Particle3D p;
+            float interp = static_cast<float>(j) / (numBondParticles - 1);
+            p.position = pos1 * (1.0f - interp) + pos2 * interp;
+            p.originalPosition = p.position;
+            p.size = 1.5f;
+            p.velocity = sf::Vector3f(0, 0, 0);
+            p.color = sf::Color(200, 200, 200, 150);
+            p.isOrbiting = false;
+            p.layer = 2;
+            particles.push_back(p);
+        }
+    }
+}
+const char* shapeName(ShapeType shape) {
+    static const char* shapeNames[TOTAL_SHAPES] = {
+        "3D Hollow Sphere",
+        "Hollow Cube",
+        "3D Figure-8 Spiral",
+        "Atomic Model",
+        "3D Heart",
+        "Double Helix"
+    };
+    return shape >= 0 && shape < TOTAL_SHAPES ? shapeNames[shape] : "";
+}
+std::string describeLayer(ShapeType shape, int layer) {
+    std::ostringstream name;
+    switch(shape) {
+        case SPHERE_3D:
+            if (layer < 12) name << "Shell " << layer;
+            else name << "Connection";
+            break;
+        case HOLLOW_CUBE:
+            if (layer < 12) name << "Edge " << layer;
+            else name << "Face " << layer - 12;
+            break;
+        case FIGURE8_SPIRAL:
+            if (layer < 15) name << "Slice " << layer;
+            else name << "Connection";
+            break;
+        case ATOMIC_MODEL:
+            if (layer == 0) name << "Nucleus";
+            else name << "Orbit " << layer;
+            break;
+        case HEART_3D:
+            if (layer < 12) name << "Layer " << layer;
+            else name << "Inner";
+            break;
+        case DOUBLE_HELIX:
+            if (layer < 2) name << "Strand " << (layer == 0 ? "A" : "B");
+            else name << "Bond";
+            break;
+        default:
+            name << layer;
+            break;
+    }
+    return name.str();
+}
+void generateShape(ShapeType shape, std::vector<Particle3D>& particles, const ShapeParams& params, float shapeScale, float hueOffset, float time) {
+    switch(shape) {
+        case SPHERE_3D: generateSphere3D(particles, params, shapeScale, hueOffset, time); break;
+        case HOLLOW_CUBE: generateHollowCube(particles, params, shapeScale, hueOffset, time); break;
+        case FIGURE8_SPIRAL: generateFigure8Spiral(particles, params, shapeScale, hueOffset, time); break;
+        case ATOMIC_MODEL: generateAtomicModel(particles, params, shapeScale, hueOffset, time); break;
+        case HEART_3D: generateHeart3D(particles, params, shapeScale, hueOffset, time); break;
+        case DOUBLE_HELIX: generateDoubleHelix(particles, params, shapeScale, hueOffset, time); break;
+        default: break;
+    }
+}
+sf::Vector3f applyDistortion(const sf::Vector3f& original, const Distortion& distortion, float time) {
+    float distance = sqrt(original.x*original.x + original.y*original.y + original.z*original.z);
+    if (distance <= 0.1f) return original;
+    float wave = sin(distance * 0.05f + time * 2.0f) * distortion.amount;
+    float twist = cos(distance * 0.03f + time) * distortion.amount * 0.5f;
+    sf::Vector3f position = original + distortion.axis * wave;
+    // Thêm twist
+    float tempX = position.x * cos(twist) - position.y * sin(twist);
+    float tempY = position.x * sin(twist) + position.y * cos(twist);
+    position.x = tempX;
+    position.y = tempY;
+    return position;
+}
+// Cải thiện distortion: Làm mượt hơn, thêm multi-axis
+void distortParticles(std::vector<Particle3D>& particles, const Distortion& distortion, float time) {
+    int n = static_cast<int>(particles.size());
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        particles[i].position = applyDistortion(particles[i].originalPosition, distortion, time);
+    }
+}
+void updateElectrons(std::vector<Particle3D>& particles, std::vector<TrailPoint>& trails,
+                     bool emitTrails, float trailLength, float deltaTime) {
+    for (auto& p : particles) {
+        if (p.isOrbiting) {
+            p.orbitAngle += deltaTime * p.orbitSpeed;
+            float tilt = (p.orbitRadius / 60.0f - 1.0f) * 0.3f; // Dựa vào radius
+            float x = p.orbitRadius * cos(p.orbitAngle);
+            float y = p.orbitRadius * sin(p.orbitAngle) * cos(tilt);
+            float z = p.orbitRadius * sin(p.orbitAngle) * sin(tilt);
+            p.position = sf::Vector3f(x, y, z);
+            if (!emitTrails) continue;
+            // Trails
+            TrailPoint trail;
+            trail.position = p.position;
+            trail.color = p.color;
+            trail.color.a = 120;
+            trail.lifetime = 0.8f * trailLength; // Dài hơn
+            trails.push_back(trail);
+        }
+    }
+}
+void sampleVelocityTrails(const std::vector<Particle3D>& particles, std::vector<TrailPoint>& trails,
+                          float trailSampling, float trailLength) {
+    if (particles.size() <= 100) return;
+    int trailSamples = static_cast<int>(std::min(10, static_cast<int>(particles.size() / 100)) * trailSampling);
+    for (int i = 0; i < trailSamples; i++) {
+        int idx = rand() % particles.size();
+        const auto& p = particles[idx];
+        float speed = sqrt(p.velocity.x*p.velocity.x + p.velocity.y*p.velocity.y + p.velocity.z*p.velocity.z);
+        if (speed > 0.1f) {
+            TrailPoint trail;
+            trail.position = p.position;
+            trail.color = p.color;
+            trail.color.a = 60;
+            trail.lifetime = 0.4f * trailLength;
+            trails.push_back(trail);
+        }
+    }
+}
+void updateTrails(std::vector<TrailPoint>& trails, float deltaTime) {
+    for (auto& trail : trails) {
+        trail.lifetime -= deltaTime;
+    }
+    trails.erase(std::remove_if(trails.begin(), trails.end(),
+        [](const TrailPoint& t) { return t.lifetime <= 0.0f; }),
+        trails.end());
+}
+void buildTrailVertices(const std::vector<TrailPoint>& trails, const Camera& camera,
+                        float trailLength, sf::VertexArray& vertices) {
+    vertices.clear();
+    for (const auto& trail : trails) {
+        if (trail.lifetime > 0.0f) {
+            sf::Vector3f rotated = rotatePoint(trail.position, camera);
+            sf::Vector2f projected = projectPoint(rotated, camera);
+            float depth = rotated.z + camera.distance;
+            if (depth > 0 && depth < 2000.0f) {
+                sf::Color trailColor = trail.color;
+                float fade = std::min(1.0f, trail.lifetime / (0.8f * trailLength));
+                trailColor.a = static_cast<sf::Uint8>(trail.color.a * fade);
+                vertices.append(sf::Vertex(projected, trailColor));
+            }
+        }
+    }
+}
+// Bảng cos/sin cho hình tròn - hạt nhỏ dùng ít đoạn hơn
+static const int CIRCLE_SEGMENTS_SMALL = 10;
+static const int CIRCLE_SEGMENTS_LARGE = 20;
+struct CircleTable {
+    sf::Vector2f small[CIRCLE_SEGMENTS_SMALL + 1];
+    sf::Vector2f large[CIRCLE_SEGMENTS_LARGE + 1];
+    CircleTable() {
+        for (int i = 0; i <= CIRCLE_SEGMENTS_SMALL; i++) {
+            float a = 2.0f * PI * i / CIRCLE_SEGMENTS_SMALL;
+            small[i] = sf::Vector2f(cos(a), sin(a));
+        }
+        for (int i = 0; i <= CIRCLE_SEGMENTS_LARGE; i++) {
+            float a = 2.0f * PI * i / CIRCLE_SEGMENTS_LARGE;
+            large[i] = sf::Vector2f(cos(a), sin(a));
+        }
+    }
+};
+static const CircleTable circleTable;
+void buildParticleVertices(const std::vector<ProjectedParticle>& projected, const QualitySettings& quality,
+                           sf::VertexArray& points, sf::VertexArray& triangles,
+                           const std::vector<unsigned char>* highlight) {
+    points.clear();
+    triangles.clear();
+    for (size_t i = 0; i < projected.size(); i++) {
+        ProjectedParticle p = projected[i];
+        if (!p.visible) continue;
+        if (highlight && (*highlight)[i]) {
+            p.color = sf::Color(255, 255, 160, 255);
+            p.size = std::max(p.size, 2.0f);
+        }
+        if (p.size < quality.lodThreshold) {
+            points.append(sf::Vertex(p.screen, p.color));
+            continue;
+        }
+        bool small = p.size < 3.0f;
+        int segments = small ? CIRCLE_SEGMENTS_SMALL : CIRCLE_SEGMENTS_LARGE;
+        const sf::Vector2f* unit = small ? circleTable.small : circleTable.large;
+        // Hình tròn đặc: quạt tam giác quanh tâm
+        for (int s = 0; s < segments; s++) {
+            triangles.append(sf::Vertex(p.screen, p.color));
+            triangles.append(sf::Vertex(p.screen + unit[s] * p.size, p.color));
+            triangles.append(sf::Vertex(p.screen + unit[s + 1] * p.size, p.color));
+        }
+        if (quality.glow) {
+            // Viền glow dày 1.5px bên ngoài, giống outline của sf::CircleShape
+            sf::Color glowColor = p.color;
+            glowColor.a = 60;
+            float outer = p.size + 1.5f;
+            for (int s = 0; s < segments; s++) {
+                sf::Vector2f i0 = p.screen + unit[s] * p.size;
+                sf::Vector2f i1 = p.screen + unit[s + 1] * p.size;
+                sf::Vector2f o0 = p.screen + unit[s] * outer;
+                sf::Vector2f o1 = p.screen + unit[s + 1] * outer;
+                triangles.append(sf::Vertex(i0, glowColor));
+                triangles.append(sf::Vertex(o0, glowColor));
+                triangles.append(sf::Vertex(o1, glowColor));
+                triangles.append(sf::Vertex(i0, glowColor));
+                triangles.append(sf::Vertex(o1, glowColor));
+                triangles.append(sf::Vertex(i1, glowColor));
+            }
+        }
+    }
+}
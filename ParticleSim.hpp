@@ -0,0 +1,270 @@
+#ifndef PARTICLE_SIM_HPP
+#define PARTICLE_SIM_HPP
+// Phần mô phỏng và toán học của ParticleMorph3D, tách khỏi cửa sổ SFML
+// để dùng chung cho ứng dụng (main.cpp) và bộ micro-benchmark (bench/kernel_bench.cpp)
+#include <SFML/Graphics.hpp>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <string>
+const int WIDTH = 1200;
+const int HEIGHT = 800;
+const float PI = 3.14159265358979323846f;
+// Lưới bin màn hình dùng cho picking
+const int SCREEN_BIN_SIZE = 16; // px
+const int SCREEN_BIN_COLUMNS = (WIDTH + SCREEN_BIN_SIZE - 1) / SCREEN_BIN_SIZE;
+const int SCREEN_BIN_ROWS = (HEIGHT + SCREEN_BIN_SIZE - 1) / SCREEN_BIN_SIZE;
+// Ô của ID buffer dùng cho hover / click: mỗi ô giữ hạt gần camera nhất, SCREEN_BIN_SIZE phải chia hết cho nó
+const int SCREEN_PICK_CELL_SIZE = 2; // px
+const int SCREEN_PICK_COLUMNS = SCREEN_BIN_COLUMNS * (SCREEN_BIN_SIZE / SCREEN_PICK_CELL_SIZE);
+const int SCREEN_PICK_ROWS = SCREEN_BIN_ROWS * (SCREEN_BIN_SIZE / SCREEN_PICK_CELL_SIZE);
+struct Particle3D {
+    sf::Vector3f position;
+    sf::Vector3f originalPosition;
+    sf::Vector3f velocity;
+    sf::Color color;
+    float size;
+    float angle;
+    float speed;
+    bool isOrbiting;
+    sf::Vector3f orbitCenter;
+    float orbitRadius;
+    float orbitAngle;
+    float orbitSpeed;
+    int layer; // Lớp / thành phần của generator đã sinh ra hạt (xem describeLayer)
+};
+struct TrailPoint {
+    sf::Vector3f position;
+    sf::Color color;
+    float lifetime;
+};
+enum ShapeType {
+    SPHERE_3D,
+    HOLLOW_CUBE,
+    FIGURE8_SPIRAL,
+    ATOMIC_MODEL,
+    HEART_3D,
+    DOUBLE_HELIX,
+    TOTAL_SHAPES
+};
+// Tham số hình dạng cụ thể
+struct ShapeParams {
+    float sphereRadius;
+    float cubeSize;
+    float figure8Scale;
+    float atomNucleusSize;
+    float heartScale;
+    float helixRadius;
+    float density; // Hệ số nhân số hạt của mỗi generator (1 = mặc định)
+};
+ShapeParams defaultShapeParams();
+// Trạng thái camera cần cho rotatePoint / projectPoint
+struct Camera {
+    float distance;
+    float angleX, angleY, angleZ;
+    float shapeScale;
+};
+struct Distortion {
+    float amount;
+    sf::Vector3f axis;
+};
+// Kết quả chiếu một hạt lên màn hình
+struct ProjectedParticle {
+    sf::Vector2f screen;
+    float depth;
+    float size;      // Bán kính trên màn hình (px)
+    sf::Color color; // Màu đã áp fade theo độ sâu
+    bool visible;
+    int bin;         // Ô của ScreenBinGrid chứa hạt, -1 nếu ngoài màn hình
+};
+// Lưới bin trong không gian màn hình cho hover / click / box selection.
+// Ô của từng hạt đã được tính sẵn trong lúc chiếu, build chỉ còn counting sort O(n).
+// Kèm theo là một ID buffer (ô SCREEN_PICK_CELL_SIZE px chỉ giữ hạt gần camera nhất) nên truy vấn gần nhất
+// duyệt số ô cố định quanh con trỏ, không phụ thuộc số hạt; box selection tỉ lệ với số hạt nằm trong box.
+struct ScreenBinGrid {
+    std::vector<int> binStart; // SCREEN_BIN_COLUMNS * SCREEN_BIN_ROWS + 1 phần tử
+    std::vector<int> binFill;
+    std::vector<int> entries;  // Chỉ số vào projected, sắp theo ô
+    std::vector<int> pickCell; // SCREEN_PICK_COLUMNS * SCREEN_PICK_ROWS, chỉ số hạt trước nhất của ô hoặc -1
+    std::vector<unsigned char> binFilled; // Bin đã ghi vào pickCell ở lần build trước
+    void build(const std::vector<ProjectedParticle>& projected);
+    void clear();
+    // Hạt hiển thị gần point nhất trong bán kính maxDistance (px), -1 nếu không có.
+    // Hạt bị hạt khác che trong cùng ô ID buffer thì không được chọn
+    int nearest(sf::Vector2f point, float maxDistance, const std::vector<ProjectedParticle>& projected) const;
+    // Thêm vào out mọi hạt hiển thị nằm trong box
+    void selectBox(const sf::FloatRect& box, const std::vector<ProjectedParticle>& projected, std::vector<int>& out) const;
+};
+// Đám hạt bất biến dùng chung - nhiều ShapeInstance cùng trỏ tới một cloud thay vì mỗi bản sao một vector
+typedef std::vector<Particle3D> PointCloud;
+typedef std::shared_ptr<const PointCloud> PointCloudPtr;
+// Một bản thể của hình trong scene: chỉ lưu transform riêng, dữ liệu hạt nằm ở cloud
+struct ShapeInstance {
+    PointCloudPtr cloud;
+    sf::Vector3f offset; // Vị trí trong scene
+    float scale;
+    float spinSpeed;     // Tốc độ quay quanh trục Y (rad/s)
+    float phase;         // Pha animation
+    sf::Color tint;      // Nhân vào màu hạt
+};
+// Chỉ giữ cloud của hình đang vẽ: sinh lại (với hue hiện tại) khi đổi hình, shapeScale hoặc density,
+// cloud cũ được giải phóng ngay khi không còn bản thể nào trỏ tới. Giống đường hình đơn, màu chỉ cập nhật
+// khi sinh lại nên đổi kích thước bức tường dùng lại cloud thay vì sinh lại mỗi lần hue đổi.
+struct PointCloudCache {
+    PointCloudPtr cloud;
+    ShapeType shape;
+    float shapeScale;
+    float density;
+    PointCloudCache() : shape(SPHERE_3D), shapeScale(1.0f), density(1.0f) {}
+    PointCloudPtr get(ShapeType shape, const ShapeParams& params, float shapeScale, float hueOffset, float time);
+    void clear(); // Giải phóng cloud khi tắt bức tường
+};
+// Lưới băm không gian đều cho truy vấn hàng xóm - xây lại mỗi bước trong O(n) bằng counting sort
+struct SpatialHashGrid {
+    float cellSize;
+    unsigned int tableMask;
+    std::vector<unsigned int> particleCell; // Ô băm của từng điểm
+    std::vector<int> cellStart;             // Vị trí bắt đầu của mỗi ô trong sortedIndices (tableSize + 1 phần tử)
+    std::vector<int> cellFill;
+    std::vector<int> sortedIndices;         // Chỉ số điểm sắp xếp theo ô (slot -> chỉ số)
+    SpatialHashGrid() : cellSize(1.0f), tableMask(0) {}
+    int cellCoord(float v) const {
+        return static_cast<int>(std::floor(v / cellSize));
+    }
+    unsigned int hashCell(int ix, int iy, int iz) const {
+        return ((static_cast<unsigned int>(ix) * 73856093u) ^
+                (static_cast<unsigned int>(iy) * 19349663u) ^
+                (static_cast<unsigned int>(iz) * 83492791u)) & tableMask;
+    }
+    // positions phải hữu hạn - NaN sẽ dồn mọi điểm vào cùng một ô
+    void build(const std::vector<sf::Vector3f>& positions, float size);
+    // Gọi func(slot) cho mọi điểm trong 8 ô quanh pos (slot là vị trí trong sortedIndices), ô chứa pos trước tiên.
+    // Ô có kích thước gấp đôi bán kính truy vấn nên chỉ cần ô chứa pos và ô kề về phía nửa ô gần pos hơn,
+    // ít lần tra bảng băm hơn nhiều so với 27 ô. func trả về false để dừng sớm; ô trùng băm chỉ duyệt một lần.
+    template <typename Func>
+    void forEachNeighbor(const sf::Vector3f& pos, Func func) const {
+        float fx = pos.x / cellSize, fy = pos.y / cellSize, fz = pos.z / cellSize;
+        int cx = static_cast<int>(std::floor(fx)), cy = static_cast<int>(std::floor(fy)), cz = static_cast<int>(std::floor(fz));
+        int sx = fx - cx < 0.5f ? -1 : 1, sy = fy - cy < 0.5f ? -1 : 1, sz = fz - cz < 0.5f ? -1 : 1;
+        unsigned int visited[8];
+        int visitedCount = 0;
+        for (int m = 0; m < 8; m++) {
+            unsigned int h = hashCell(cx + (m & 1 ? sx : 0), cy + (m & 2 ? sy : 0), cz + (m & 4 ? sz : 0));
+            int begin = cellStart[h], end = cellStart[h + 1];
+            if (begin == end) continue;
+            bool seen = false;
+            for (int v = 0; v < visitedCount; v++) {
+                if (visited[v] == h) { seen = true; break; }
+            }
+            if (seen) continue;
+            visited[visitedCount++] = h;
+            for (int k = begin; k < end; k++) {
+                if (!func(k)) return;
+            }
+        }
+    }
+};
+// Động lực học: kéo về originalPosition, chuột phải đẩy hạt, giảm chấn, tách rời + bầy đàn với hàng xóm gần.
+// Hàng xóm tra qua SpatialHashGrid, mỗi hạt xét tối đa maxNeighbors hàng xóm (maxCandidates ứng viên) và bán kính
+// tự co theo khoảng cách giữa các hạt (giữ số hạt mỗi ô quanh cellOccupancy) nên chi phí mỗi hạt không tăng theo mật độ.
+// Tách rời chỉ chống lại phần bị nén so với khoảng cách giữa hai vị trí đích, nên lúc nghỉ hình giữ nguyên.
+struct ParticleDynamics {
+    struct {
+        float attraction;         // Lực kéo về originalPosition
+        float damping;            // Giảm chấn (1/s)
+        float mouseRadius;        // Bán kính đẩy của chuột (pixel)
+        float mouseStrength;
+        float neighborRadius;     // Bán kính tương tác lớn nhất giữa các hạt (ô lưới = 2 lần bán kính)
+        float minNeighborRadius;  // Giới hạn dưới khi bán kính tự co theo mật độ
+        float cellOccupancy;      // Số hạt trung bình mong muốn trong mỗi ô có hạt
+        int maxNeighbors;         // Số hàng xóm tối đa mỗi hạt xét trong một bước
+        int maxCandidates;        // Số hạt tối đa được kiểm tra khoảng cách khi tìm hàng xóm
+        float separationStrength;
+        float alignmentStrength;  // Bầy đàn: hòa vận tốc với hàng xóm
+    } params;
+    float radius;                 // Bán kính tương tác đang dùng, tự chỉnh theo mật độ sau mỗi bước
+    SpatialHashGrid grid;
+    std::vector<int> active;      // Hạt được mô phỏng: không quay quỹ đạo, tọa độ hữu hạn
+    std::vector<sf::Vector3f> positions, targets;
+    // Dữ liệu của hàng xóm chép liền nhau theo thứ tự ô để vòng lặp hàng xóm đọc tuần tự
+    std::vector<sf::Vector3f> sortedPosition, sortedTarget, sortedVelocity;
+    std::vector<sf::Vector3f> accel;
+    ParticleDynamics();
+    void step(std::vector<Particle3D>& particles, const Camera& camera, const Distortion& distortion,
+              bool repelling, sf::Vector2f mouse, float time, float deltaTime);
+    void reset(std::vector<Particle3D>& particles) const;
+};
+// Một mức chất lượng: các núm mà governor được phép vặn
+struct QualitySettings {
+    float visibleFraction; // Tỉ lệ hạt được vẽ
+    float lodThreshold;    // Hạt có kích thước chiếu (px) nhỏ hơn ngưỡng này được vẽ dạng điểm thay vì hình tròn
+    float trailLength;     // Hệ số nhân thời gian sống của trail
+    float trailSampling;   // Hệ số nhân tần suất lấy mẫu trail
+    bool glow;             // Viền glow quanh hạt
+};
+// Governor giữ frame time quanh ngân sách: đo thời gian các stage rồi hạ/nâng mức chất lượng.
+// Hysteresis: ngưỡng hạ và nâng cách xa nhau, phải vượt ngưỡng đủ lâu, có cooldown sau mỗi lần đổi,
+// và nếu vừa nâng mức đã phải hạ lại thì lần nâng sau phải chờ lâu gấp đôi.
+struct QualityGovernor {
+    static const int LEVELS = 5;
+    int level;               // 0 = thấp nhất, LEVELS - 1 = đầy đủ
+    bool locked;
+    float targetFrameTime;   // Ngân sách (giây)
+    float smoothedTime;      // EMA thời gian update + render
+    float overBudgetTime;
+    float underBudgetTime;
+    float cooldown;
+    float upgradeHoldTime;   // Thời gian phải dư ngân sách trước khi nâng mức
+    float sinceUpgrade;
+    QualityGovernor();
+    QualitySettings settings() const;
+    void setLevel(int newLevel);
+    void record(float stageTime, float deltaTime);
+};
+// Màu sắc
+sf::Color hslToColor(float h, float s, float l);
+// Camera
+sf::Vector3f rotatePoint(sf::Vector3f point, const Camera& camera);
+sf::Vector2f projectPoint(sf::Vector3f point, const Camera& camera);
+// Nghịch đảo phép xoay camera (không scale) - đưa hướng trong không gian màn hình về không gian hình
+sf::Vector3f inverseRotateDirection(sf::Vector3f dir, const Camera& camera);
+// Xoay + chiếu cả mảng hạt (song song); visibleFraction rải đều số hạt được giữ lại
+void projectParticles(const std::vector<Particle3D>& particles, const Camera& camera,
+                      float visibleFraction, std::vector<ProjectedParticle>& projected);
+// Chỉ chiếu các hạt trong indices (ví dụ electron) - projected[k] ứng với particles[indices[k]]
+void projectParticleSubset(const std::vector<Particle3D>& particles, const std::vector<int>& indices,
+                           const Camera& camera, float visibleFraction, std::vector<ProjectedParticle>& projected);
+// Chiếu instances[first, first + count) theo lô, đọc thẳng từ cloud dùng chung của từng instance
+void projectInstances(const std::vector<ShapeInstance>& instances, size_t first, size_t count,
+                      const Camera& camera, float visibleFraction, float time,
+                      std::vector<ProjectedParticle>& projected);
+// Generators - ghi đè particles bằng hình mới
+void generateSphere3D(std::vector<Particle3D>& particles, const ShapeParams& params, float shapeScale, float hueOffset, float time);
+void generateHollowCube(std::vector<Particle3D>& particles, const ShapeParams& params, float shapeScale, float hueOffset, float time);
+void generateFigure8Spiral(std::vector<Particle3D>& particles, const ShapeParams& params, float shapeScale, float hueOffset, float time);
+void generateAtomicModel(std::vector<Particle3D>& particles, const ShapeParams& params, float shapeScale, float hueOffset, float time);
+void generateHeart3D(std::vector<Particle3D>& particles, const ShapeParams& params, float shapeScale, float hueOffset, float time);
+void generateDoubleHelix(std::vector<Particle3D>& particles, const ShapeParams& params, float shapeScale, float hueOffset, float time);
+void generateShape(ShapeType shape, std::vector<Particle3D>& particles, const ShapeParams& params, float shapeScale, float hueOffset, float time);
+// Biến dạng
+sf::Vector3f applyDistortion(const sf::Vector3f& original, const Distortion& distortion, float time);
+void distortParticles(std::vector<Particle3D>& particles, const Distortion& distortion, float time);
+// Electron + trails
+void updateElectrons(std::vector<Particle3D>& particles, std::vector<TrailPoint>& trails,
+                     bool emitTrails, float trailLength, float deltaTime);
+void sampleVelocityTrails(const std::vector<Particle3D>& particles, std::vector<TrailPoint>& trails,
+                          float trailSampling, float trailLength);
+void updateTrails(std::vector<TrailPoint>& trails, float deltaTime);
+// Dựng vertex để vẽ theo lô
+void buildTrailVertices(const std::vector<TrailPoint>& trails, const Camera& camera,
+                        float trailLength, sf::VertexArray& vertices);
+// Hạt dưới ngưỡng LOD -> points, còn lại -> triangles (hình tròn + viền glow)
+// highlight (nếu có) đánh dấu hạt đang được chọn, cùng chỉ số với projected - tô sáng ngay trong lượt dựng này
+void buildParticleVertices(const std::vector<ProjectedParticle>& projected, const QualitySettings& quality,
+                           sf::VertexArray& points, sf::VertexArray& triangles,
+                           const std::vector<unsigned char>* highlight = 0);
+const char* shapeName(ShapeType shape);
+// Tên lớp generator của hạt (ví dụ "Shell 3", "Orbit 2", "Bond") để hiển thị khi inspect
+std::string describeLayer(ShapeType shape, int layer);
+#endif // PARTICLE_SIM_HPP
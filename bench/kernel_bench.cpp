@@ -0,0 +1,333 @@
+// Micro-benchmark cho các kernel trong ParticleSim (không mở cửa sổ, chạy được trên Linux headless)
+//
+// Dùng:
+//   kernel_bench [--baseline file] [--threshold 0.25] [--update] [--quick]
+//
+// Mỗi kernel chạy ở nhiều số lượng hạt, lấy thời gian nhỏ nhất của nhiều mẫu; kernel ngắn được gọi
+// nhiều lần trong một mẫu để mỗi mẫu kéo dài ít nhất ~50 us, kết quả là thời gian một lần gọi.
+// Nếu file baseline chưa có (hoặc có --update) thì kết quả được ghi vào đó;
+// ngược lại so sánh với baseline và trả về mã lỗi 1 khi có kernel chậm hơn quá ngưỡng.
+// Kernel chưa có trong baseline (vừa thêm vào benchmark) được in ra và ghi nối vào file.
+#include "ParticleSim.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+struct BenchResult {
+    std::string name;
+    int count;
+    double nanoseconds; // Thời gian một lần gọi kernel
+};
+static volatile float benchSink = 0.0f; // Chặn compiler bỏ kết quả
+// Lặp các mẫu tới khi đủ minSeconds và ít nhất minReps mẫu, trả về thời gian một lần gọi của mẫu nhanh nhất (ns).
+// Mỗi mẫu gọi kernel batch lần, batch chọn từ lần warm-up sao cho mẫu dài ít nhất minSampleNs
+static double measure(const std::function<void()>& kernel, double minSeconds) {
+    typedef std::chrono::steady_clock Clock;
+    const int minReps = 5;
+    const double minSampleNs = 50000.0;
+    Clock::time_point warmupStart = Clock::now();
+    kernel(); // Warm-up
+    double warmupNs = std::chrono::duration<double, std::nano>(Clock::now() - warmupStart).count();
+    int batch = static_cast<int>(std::min(1e6, std::ceil(minSampleNs / std::max(1.0, warmupNs))));
+    double best = 1e300;
+    double total = 0.0;
+    int reps = 0;
+    while (reps < minReps || total < minSeconds) {
+        Clock::time_point start = Clock::now();
+        for (int b = 0; b < batch; b++) kernel();
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        best = std::min(best, ns / batch);
+        total += ns * 1e-9;
+        reps++;
+    }
+    return best;
+}
+static Camera benchCamera() {
+    Camera camera;
+    camera.distance = 500.0f;
+    camera.angleX = 0.5f;
+    camera.angleY = 0.3f;
+    camera.angleZ = 0.1f;
+    camera.shapeScale = 1.0f;
+    return camera;
+}
+// Đám hạt tổng hợp đúng count phần tử, lấy từ hình cầu với mật độ đủ lớn
+static std::vector<Particle3D> makeParticles(int count) {
+    ShapeParams params = defaultShapeParams();
+    std::vector<Particle3D> particles;
+    generateSphere3D(particles, params, 1.0f, 0.0f, 0.0f);
+    params.density = std::max(1.0f, static_cast<float>(count) / particles.size() + 0.1f);
+    generateSphere3D(particles, params, 1.0f, 0.0f, 0.0f);
+    particles.resize(count);
+    return particles;
+}
+static std::string resultKey(const std::string& name, int count) {
+    std::ostringstream key;
+    key << name << "@" << count;
+    return key.str();
+}
+static std::map<std::string, double> loadBaseline(const std::string& path) {
+    std::map<std::string, double> baseline;
+    std::ifstream in(path.c_str());
+    std::string name;
+    int count;
+    double ns;
+    while (in >> name >> count >> ns) {
+        baseline[resultKey(name, count)] = ns;
+    }
+    return baseline;
+}
+static void saveBaseline(const std::string& path, const std::vector<BenchResult>& results, bool append = false) {
+    std::ofstream out(path.c_str(), append ? std::ios::app : std::ios::trunc);
+    for (const auto& r : results) {
+        out << r.name << " " << r.count << " " << r.nanoseconds << "\n";
+    }
+}
+// 1000 truy vấn hover rải trên vùng giữa màn hình
+static double measurePick(const ScreenBinGrid& pickGrid, const std::vector<ProjectedParticle>& projected, double minSeconds) {
+    return measure([&]() {
+        int acc = 0;
+        for (int q = 0; q < 1000; q++) {
+            sf::Vector2f point(400.0f + (q % 40) * 10.0f, 200.0f + (q / 40) * 16.0f);
+            acc += pickGrid.nearest(point, 12.0f, projected);
+        }
+        benchSink = static_cast<float>(acc);
+    }, minSeconds);
+}
+// Chi phí mỗi truy vấn picking không được tăng theo số hạt: đo ở 10k và 100k hạt (ID buffer quanh các điểm
+// truy vấn đã gần đầy ở cả hai mức, duyệt tuyến tính sẽ chậm ~x10). Trả về 1 nếu tăng quá maxRatio lần
+static int checkPickScaling(const Camera& camera, double minSeconds, double maxRatio) {
+    double nanoseconds[2];
+    int counts[2] = {10000, 100000};
+    for (int c = 0; c < 2; c++) {
+        std::vector<Particle3D> particles = makeParticles(counts[c]);
+        std::vector<ProjectedParticle> projected;
+        projectParticles(particles, camera, 1.0f, projected);
+        ScreenBinGrid pickGrid;
+        pickGrid.build(projected);
+        nanoseconds[c] = measurePick(pickGrid, projected, minSeconds);
+    }
+    double ratio = nanoseconds[1] / nanoseconds[0];
+    std::printf("screen_pick_1000 scaling: %d -> %d particles, %.0f ns -> %.0f ns (x%.2f, limit x%.1f)\n",
+        counts[0], counts[1], nanoseconds[0], nanoseconds[1], ratio, maxRatio);
+    if (ratio <= maxRatio) return 0;
+    std::printf("NOT FLAT   screen_pick_1000 cost grows with particle count\n");
+    return 1;
+}
+// Đo mọi kernel ở từng số lượng hạt, thêm kết quả vào results theo thứ tự cố định
+static void runKernels(const std::vector<int>& counts, double minSeconds, std::vector<BenchResult>& results) {
+    Camera camera = benchCamera();
+    Distortion distortion;
+    distortion.amount = 0.8f;
+    distortion.axis = sf::Vector3f(0.0f, 1.0f, 0.0f);
+    QualitySettings fullQuality = QualityGovernor().settings();
+    std::vector<std::string> names;
+    names.push_back("generate_sphere");
+    names.push_back("generate_cube");
+    names.push_back("generate_figure8");
+    names.push_back("generate_atomic");
+    names.push_back("generate_heart");
+    names.push_back("generate_helix");
+    for (size_t c = 0; c < counts.size(); c++) {
+        int count = counts[c];
+        std::vector<BenchResult> batch;
+        // hslToColor
+        batch.push_back(BenchResult{"hsl_to_color", count, measure([&]() {
+            unsigned int acc = 0;
+            for (int i = 0; i < count; i++) {
+                sf::Color color = hslToColor(i * 0.37f, 0.8f, 0.6f);
+                acc += color.r + color.g + color.b;
+            }
+            benchSink = static_cast<float>(acc);
+        }, minSeconds)});
+        // rotatePoint + projectPoint từng điểm (đường cũ của render) và bản theo mảng
+        std::vector<Particle3D> particles = makeParticles(count);
+        batch.push_back(BenchResult{"rotate_project_scalar", count, measure([&]() {
+            float acc = 0.0f;
+            for (const auto& p : particles) {
+                sf::Vector2f screen = projectPoint(rotatePoint(p.position, camera), camera);
+                acc += screen.x + screen.y;
+            }
+            benchSink = acc;
+        }, minSeconds)});
+        std::vector<ProjectedParticle> projected;
+        batch.push_back(BenchResult{"project_particles", count, measure([&]() {
+            projectParticles(particles, camera, 1.0f, projected);
+        }, minSeconds)});
+        // Lưới picking màn hình: build từ kết quả chiếu, 1000 truy vấn hover, box selection nửa màn hình
+        ScreenBinGrid pickGrid;
+        batch.push_back(BenchResult{"screen_bin_build", count, measure([&]() {
+            pickGrid.build(projected);
+        }, minSeconds)});
+        batch.push_back(BenchResult{"screen_pick_1000", count, measurePick(pickGrid, projected, minSeconds)});
+        std::vector<int> boxHits;
+        batch.push_back(BenchResult{"screen_box_select", count, measure([&]() {
+            boxHits.clear();
+            pickGrid.selectBox(sf::FloatRect(WIDTH / 4.0f, HEIGHT / 4.0f, WIDTH / 2.0f, HEIGHT / 2.0f), projected, boxHits);
+        }, minSeconds)});
+        // 16 bản thể dùng chung một cloud count/16 hạt
+        PointCloudPtr sharedCloud(new PointCloud(makeParticles(count / 16)));
+        std::vector<ShapeInstance> instances(16);
+        for (size_t k = 0; k < instances.size(); k++) {
+            instances[k].cloud = sharedCloud;
+            instances[k].offset = sf::Vector3f((k % 4) * 60.0f - 90.0f, (k / 4) * 60.0f - 90.0f, 0.0f);
+            instances[k].scale = 0.25f;
+            instances[k].spinSpeed = 1.0f;
+            instances[k].phase = k * 0.5f;
+            instances[k].tint = sf::Color(255, 200, 200, 255);
+        }
+        batch.push_back(BenchResult{"project_instances", count, measure([&]() {
+            projectInstances(instances, 0, instances.size(), camera, 1.0f, 1.0f, projected);
+        }, minSeconds)});
+        // Generators: mật độ được chọn để số hạt xấp xỉ count
+        for (int shape = 0; shape < TOTAL_SHAPES; shape++) {
+            ShapeParams params = defaultShapeParams();
+            std::vector<Particle3D> generated;
+            generateShape(static_cast<ShapeType>(shape), generated, params, 1.0f, 0.0f, 0.0f);
+            params.density = static_cast<float>(count) / generated.size();
+            batch.push_back(BenchResult{names[shape], count, measure([&]() {
+                generateShape(static_cast<ShapeType>(shape), generated, params, 1.0f, 0.0f, 0.0f);
+            }, minSeconds)});
+        }
+        // Vòng distortion
+        batch.push_back(BenchResult{"distort_particles", count, measure([&]() {
+            distortParticles(particles, distortion, 1.0f);
+        }, minSeconds)});
+        // Electron (mọi hạt đều quay quanh quỹ đạo, có sinh trail)
+        std::vector<Particle3D> electrons = particles;
+        for (size_t i = 0; i < electrons.size(); i++) {
+            electrons[i].isOrbiting = true;
+            electrons[i].orbitRadius = 60.0f + (i % 4) * 40.0f;
+            electrons[i].orbitAngle = i * 0.01f;
+            electrons[i].orbitSpeed = 1.0f;
+        }
+        std::vector<TrailPoint> trails;
+        trails.reserve(count);
+        batch.push_back(BenchResult{"update_electrons", count, measure([&]() {
+            trails.clear();
+            updateElectrons(electrons, trails, true, 1.0f, 1.0f / 60.0f);
+        }, minSeconds)});
+        // Trails: tuổi thọ lớn để không hạt nào bị xóa giữa các lần đo
+        for (auto& trail : trails) trail.lifetime = 1e9f;
+        batch.push_back(BenchResult{"update_trails", count, measure([&]() {
+            updateTrails(trails, 1.0f / 60.0f);
+        }, minSeconds)});
+        sf::VertexArray trailVertices(sf::Points);
+        batch.push_back(BenchResult{"build_trail_vertices", count, measure([&]() {
+            buildTrailVertices(trails, camera, 1.0f, trailVertices);
+        }, minSeconds)});
+        // Dựng vertex cho hạt (chất lượng đầy đủ: hình tròn + glow)
+        projectParticles(particles, camera, 1.0f, projected);
+        sf::VertexArray points(sf::Points);
+        sf::VertexArray triangles(sf::Triangles);
+        batch.push_back(BenchResult{"build_particle_vertices", count, measure([&]() {
+            buildParticleVertices(projected, fullQuality, points, triangles);
+        }, minSeconds)});
+        // Động lực học + lưới băm: vài bước warm-up để bán kính tự chỉnh hội tụ về mật độ của đám hạt,
+        // lưới được build đúng như trong step (vị trí các hạt đang mô phỏng, ô = 2 lần bán kính)
+        ParticleDynamics dynamics;
+        std::vector<Particle3D> moving = particles;
+        for (int warmup = 0; warmup < 10; warmup++) {
+            dynamics.step(moving, camera, distortion, false, sf::Vector2f(), 1.0f, 1.0f / 60.0f);
+        }
+        std::vector<sf::Vector3f> positions = dynamics.positions;
+        float cellSize = dynamics.grid.cellSize; // Kích thước ô của bước cuối
+        batch.push_back(BenchResult{"hash_grid_build", count, measure([&]() {
+            dynamics.grid.build(positions, cellSize);
+        }, minSeconds)});
+        batch.push_back(BenchResult{"dynamics_step", count, measure([&]() {
+            dynamics.step(moving, camera, distortion, true, sf::Vector2f(WIDTH / 2.0f, HEIGHT / 2.0f), 1.0f, 1.0f / 60.0f);
+        }, minSeconds)});
+        for (const auto& r : batch) {
+            std::printf("%-26s %10d %14.0f %12.2f\n", r.name.c_str(), r.count, r.nanoseconds, r.nanoseconds / r.count);
+            results.push_back(r);
+        }
+    }
+}
+// Số kernel chậm hơn baseline quá threshold (kernel chưa có trong baseline không tính)
+static int countRegressions(const std::vector<BenchResult>& results, const std::map<std::string, double>& baseline,
+                            double threshold, bool report) {
+    int regressions = 0;
+    for (const auto& r : results) {
+        std::map<std::string, double>::const_iterator it = baseline.find(resultKey(r.name, r.count));
+        if (it == baseline.end()) continue;
+        double ratio = r.nanoseconds / it->second;
+        if (ratio > 1.0 + threshold) {
+            if (report) {
+                std::printf("REGRESSION %-26s %10d  %.0f ns -> %.0f ns (x%.2f)\n",
+                    r.name.c_str(), r.count, it->second, r.nanoseconds, ratio);
+            }
+            regressions++;
+        }
+    }
+    return regressions;
+}
+int main(int argc, char** argv) {
+    std::string baselinePath;
+    double threshold = 0.25;
+    bool update = false;
+    bool quick = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--baseline") && i + 1 < argc) baselinePath = argv[++i];
+        else if (!strcmp(argv[i], "--threshold") && i + 1 < argc) threshold = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--update")) update = true;
+        else if (!strcmp(argv[i], "--quick")) quick = true;
+        else {
+            std::printf("Usage: %s [--baseline file] [--threshold 0.25] [--update] [--quick]\n", argv[0]);
+            return 2;
+        }
+    }
+    std::vector<int> counts;
+    counts.push_back(1000);
+    counts.push_back(10000);
+    if (!quick) counts.push_back(100000);
+    double minSeconds = quick ? 0.05 : 0.2;
+    std::vector<BenchResult> results;
+    std::printf("%-26s %10s %14s %12s\n", "kernel", "count", "ns/call", "ns/item");
+    runKernels(counts, minSeconds, results);
+    std::printf("\n");
+    int notFlat = checkPickScaling(benchCamera(), minSeconds, 2.0);
+    if (baselinePath.empty()) return notFlat;
+    std::map<std::string, double> baseline = loadBaseline(baselinePath);
+    if (update || baseline.empty()) {
+        saveBaseline(baselinePath, results);
+        std::printf("\nBaseline written to %s\n", baselinePath.c_str());
+        return 0;
+    }
+    std::vector<BenchResult> missing;
+    std::printf("\nComparing against %s (threshold +%.0f%%)\n", baselinePath.c_str(), threshold * 100.0);
+    for (const auto& r : results) {
+        if (baseline.find(resultKey(r.name, r.count)) == baseline.end()) {
+            // Kernel mới chưa có trong baseline: ghi thêm để các lần chạy sau được so sánh
+            std::printf("NEW        %-26s %10d  %.0f ns (added to baseline)\n", r.name.c_str(), r.count, r.nanoseconds);
+            missing.push_back(r);
+        }
+    }
+    int regressions = countRegressions(results, baseline, threshold, false);
+    if (regressions > 0) {
+        // Máy bận trong cả một lượt đo cũng làm kernel ngắn chậm hẳn: đo lại một lần, giữ kết quả nhanh hơn
+        std::printf("%d kernel(s) above threshold, measuring again to confirm\n", regressions);
+        std::vector<BenchResult> retry;
+        runKernels(counts, minSeconds, retry);
+        for (size_t k = 0; k < results.size(); k++) {
+            results[k].nanoseconds = std::min(results[k].nanoseconds, retry[k].nanoseconds);
+        }
+    }
+    regressions = countRegressions(results, baseline, threshold, true);
+    if (!missing.empty()) {
+        saveBaseline(baselinePath, missing, true);
+        std::printf("%d kernel(s) added to %s\n", static_cast<int>(missing.size()), baselinePath.c_str());
+    }
+    if (regressions > 0) {
+        std::printf("%d kernel(s) regressed\n", regressions);
+        return 1;
+    }
+    if (notFlat) return 1;
+    std::printf("No regressions\n");
+    return 0;
+}
@@ -1,32 +1,7 @@
-#include <SFML/Graphics.hpp>
-#include <cmath>
-#include <vector>
-#include <algorithm>
+#include "ParticleSim.hpp"
 #include <iostream>
 #include <sstream>
 #include <random>
-const int WIDTH = 1200;
-const int HEIGHT = 800;
-const float PI = 3.14159265358979323846f;
-struct Particle3D {
-    sf::Vector3f position;
-    sf::Vector3f originalPosition;
-    sf::Vector3f velocity;
-    sf::Color color;
-    float size;
-    float angle;
-    float speed;
-    bool isOrbiting;
-    sf::Vector3f orbitCenter;
-    float orbitRadius;
-    float orbitAngle;
-    float orbitSpeed;
-};
-struct TrailPoint {
-    sf::Vector3f position;
-    sf::Color color;
-    float lifetime;
-};
 class ParticleMorph3D {
 private:
     sf::RenderWindow window;
@@ -35,16 +10,46 @@ private:
     sf::Text infoText;
     std::vector<Particle3D> particles;
     std::vector<TrailPoint> trails;
-    std::vector<sf::VertexArray> trailRender;
-    enum ShapeType {
-        SPHERE_3D,
-        HOLLOW_CUBE,
-        FIGURE8_SPIRAL,
-        ATOMIC_MODEL,
-        HEART_3D,
-        DOUBLE_HELIX,
-        TOTAL_SHAPES
+    std::vector<ProjectedParticle> projected;
+    sf::VertexArray trailRender;
+    sf::VertexArray pointRender;    // Hạt dưới ngưỡng LOD, vẽ một lần dạng điểm
+    sf::VertexArray triangleRender; // Hạt còn lại: hình tròn + glow dựng thành tam giác
+    // Cache lớp hạt tĩnh: chỉ chiếu + dựng vertex + vẽ lại khi input của nó đổi
+    struct StaticLayerInputs {
+        float cameraDistance, cameraAngleX, cameraAngleY, cameraAngleZ, shapeScale;
+        unsigned int particlesVersion;
+        int qualityLevel;
+        unsigned int selectionVersion; // Chỉ đổi vùng chọn -> dựng lại vertex, không cần chiếu lại
+        bool sameProjection(const StaticLayerInputs& o) const {
+            return cameraDistance == o.cameraDistance && cameraAngleX == o.cameraAngleX &&
+                   cameraAngleY == o.cameraAngleY && cameraAngleZ == o.cameraAngleZ &&
+                   shapeScale == o.shapeScale && particlesVersion == o.particlesVersion &&
+                   qualityLevel == o.qualityLevel;
+        }
     };
+    unsigned int particlesVersion;  // Tăng mỗi khi vị trí / kích thước / màu của particles đổi
+    StaticLayerInputs staticInputs;
+    bool staticLayerValid;
+    bool staticTextureAvailable;
+    sf::RenderTexture staticLayer;  // Ảnh lớp tĩnh của frame trước
+    // Tập động (electron) được chiếu lại mỗi frame
+    std::vector<int> dynamicIndices;
+    std::vector<ProjectedParticle> dynamicProjected;
+    sf::VertexArray dynamicPointRender;
+    sf::VertexArray dynamicTriangleRender;
+    float infoTextTimer;
+    // Picking: lưới bin màn hình được điền lại mỗi khi lớp tĩnh được chiếu lại
+    ScreenBinGrid pickGrid;
+    std::vector<unsigned char> selected; // Cờ chọn theo chỉ số particles
+    std::vector<unsigned char> dynamicHighlight;
+    int selectedCount;
+    unsigned int selectionVersion;
+    int hoveredIndex;
+    bool isBoxSelecting;
+    sf::Vector2f boxStart, boxEnd;
+    sf::Vector2f pressPos;
+    bool clickSelectArmed; // Lần nhấn chuột trái hiện tại có thể là click chọn hạt (không trên nút, không giữ Shift)
+    sf::Text hoverText;
     ShapeType currentShape;
     float shapeTransition;
     bool isTransitioning;
@@ -67,22 +72,38 @@ private:
     // Biến dạng
     float distortionAmount;
     sf::Vector3f distortionAxis;
+    // Động lực học (tùy chọn)
+    bool dynamicsEnabled;
+    ParticleDynamics dynamics;
+    // Scene nhiều bản thể dùng chung point cloud
+    bool sceneMode;
+    int sceneSizeIndex;
+    std::vector<ShapeInstance> sceneInstances;
+    PointCloudCache cloudCache;
+    // Chất lượng thích ứng
+    QualityGovernor governor;
+    QualitySettings quality;
+    float electronTrailAccumulator;
+    float lastUpdateTime;
+    float lastRenderTime;
     // UI
     bool showTransformUI;
     sf::RectangleShape transformButton;
     sf::Text transformButtonText;
     // Hình dạng cụ thể
-    struct {
-        float sphereRadius;
-        float cubeSize;
-        float figure8Scale;
-        float atomNucleusSize;
-        float heartScale;
-        float helixRadius;
-    } shapeParams;
+    ShapeParams shapeParams;
 public:
     ParticleMorph3D() :
         window(sf::VideoMode(WIDTH, HEIGHT), "3D Particle Morph - Advanced Visualizer", sf::Style::Close),
+        particlesVersion(0),
+        staticLayerValid(false),
+        staticTextureAvailable(false),
+        infoTextTimer(1.0f),
+        selectedCount(0),
+        selectionVersion(0),
+        hoveredIndex(-1),
+        isBoxSelecting(false),
+        clickSelectArmed(false),
         currentShape(SPHERE_3D),
         shapeTransition(0.0f),
         isTransitioning(false),
@@ -100,20 +121,29 @@ public:
         pulse(0.0f),
         distortionAmount(0.0f),
         distortionAxis(0.0f, 1.0f, 0.0f),
+        dynamicsEnabled(false),
+        sceneMode(false),
+        sceneSizeIndex(1),
+        electronTrailAccumulator(0.0f),
+        lastUpdateTime(0.0f),
+        lastRenderTime(0.0f),
         showTransformUI(false)
     {
         window.setFramerateLimit(60);
+        trailRender.setPrimitiveType(sf::Points);
+        pointRender.setPrimitiveType(sf::Points);
+        triangleRender.setPrimitiveType(sf::Triangles);
+        dynamicPointRender.setPrimitiveType(sf::Points);
+        dynamicTriangleRender.setPrimitiveType(sf::Triangles);
+        // Không có render texture (driver cũ) thì vẫn giữ vertex đã dựng và vẽ lại chúng
+        staticTextureAvailable = staticLayer.create(WIDTH, HEIGHT);
+        quality = governor.settings();
         // Khởi tạo font
         if (!font.loadFromFile("arial.ttf")) {
             std::cout << "Font not found, continuing without text\n";
         }
         // Khởi tạo tham số hình dạng
-        shapeParams.sphereRadius = 120.0f;
-        shapeParams.cubeSize = 150.0f;
-        shapeParams.figure8Scale = 100.0f;
-        shapeParams.atomNucleusSize = 40.0f;
-        shapeParams.heartScale = 80.0f;
-        shapeParams.helixRadius = 100.0f;
+        shapeParams = defaultShapeParams();
         setupUI();
         generateCurrentShape();
     }
@@ -128,6 +158,9 @@ public:
         transformButton.setFillColor(sf::Color(50, 100, 200, 200));
         transformButton.setOutlineColor(sf::Color(100, 150, 255));
         transformButton.setOutlineThickness(2);
+        hoverText.setFont(font);
+        hoverText.setCharacterSize(14);
+        hoverText.setFillColor(sf::Color(255, 255, 160));
         transformButtonText.setFont(font);
         transformButtonText.setCharacterSize(18);
         transformButtonText.setFillColor(sf::Color::White);
@@ -137,358 +170,65 @@ public:
             transformButton.getPosition().y + 10
         );
     }
-    // Hàm tạo hình cầu 3D RỖNG (hollow) - Cải thiện: Thêm nhiều lớp hơn, màu sắc gradient mượt mà hơn, thêm hiệu ứng glow
-    void generateSphere3D() {
-        particles.clear();
-        int numLayers = 12; // Tăng số lớp cho độ mịn hơn
-        int particlesPerLayer = 300; // Tăng số hạt mỗi lớp
-        for (int layer = 0; layer < numLayers; layer++) {
-            float radiusRatio = 0.2f + (layer / (float)numLayers) * 0.8f;
-            float currentRadius = shapeParams.sphereRadius * radiusRatio;
-            for (int i = 0; i < particlesPerLayer; i++) {
-                Particle3D p;
-                float phi = acos(1.0f - 2.0f * (i + 0.5f) / particlesPerLayer);
-                float theta = PI * (1.0f + sqrt(5.0f)) * i;
-                p.position.x = currentRadius * sin(phi) * cos(theta);
-                p.position.y = currentRadius * sin(phi) * sin(theta);
-                p.position.z = currentRadius * cos(phi);
-                p.originalPosition = p.position;
-                p.size = 2.0f + 1.0f * sin(theta * 4.0f); // Variation kích thước
-                p.velocity = sf::Vector3f(0, 0, 0);
-                float hue = (layer * 30.0f + hueOffset) + sin(theta) * 10.0f; // Thêm variation hue
-                float saturation = 0.85f + 0.15f * cos(phi);
-                float lightness = 0.5f + 0.3f * sin(layer * 1.5f);
-                p.color = hslToColor(hue, saturation, lightness);
-                p.color.a = 160 + 80 * (layer % 2); // Xen kẽ alpha
-                p.isOrbiting = false;
-                particles.push_back(p);
-            }
-        }
-        // Tăng connections cho lưới dày hơn
-        int connections = 800;
-        for (int i = 0; i < connections; i++) {
-            Particle3D p;
-            float t = (rand() % 1000) / 1000.0f;
-            int layer1 = rand() % numLayers;
-            int layer2 = (layer1 + 1 + rand() % 2) % numLayers; // Kết nối xa hơn
-            float r1 = shapeParams.sphereRadius * (0.2f + (layer1 / (float)numLayers) * 0.8f);
-            float r2 = shapeParams.sphereRadius * (0.2f + (layer2 / (float)numLayers) * 0.8f);
-            float phi = acos(1.0f - 2.0f * t);
-            float theta = 2.0f * PI * t * 12.0f;
-            float currentRadius = r1 * (1.0f - t) + r2 * t;
-            p.position.x = currentRadius * sin(phi) * cos(theta);
-            p.position.y = currentRadius * sin(phi) * sin(theta);
-            p.position.z = currentRadius * cos(phi);
-            p.originalPosition = p.position;
-            p.size = 1.0f + 0.5f * sin(i * 0.1f);
-            p.velocity = sf::Vector3f(0, 0, 0);
-            p.color = sf::Color(200, 255, 255, 80 + rand() % 40); // Màu cyan mờ variation
-            p.isOrbiting = false;
-            particles.push_back(p);
-        }
-    }
-    // Hình hộp rỗng 3D - Cải thiện: Thêm hạt ở mặt để tạo cảm giác khối hơn, màu sắc đa dạng hơn
-    void generateHollowCube() {
-        particles.clear();
-        int particlesPerEdge = 50; // Tăng số hạt
-        float size = shapeParams.cubeSize * shapeScale;
-        // 12 cạnh
-        for (int edge = 0; edge < 12; edge++) {
-            for (int i = 0; i < particlesPerEdge; i++) {
-                Particle3D p;
-                float t = static_cast<float>(i) / particlesPerEdge;
-                switch(edge) {
-                    case 0: p.position = sf::Vector3f(-size, -size, -size) * (1.0f - t) + sf::Vector3f(size, -size, -size) * t; break;
-                    case 1: p.position = sf::Vector3f(size, -size, -size) * (1.0f - t) + sf::Vector3f(size, size, -size) * t; break;
-                    case 2: p.position = sf::Vector3f(size, size, -size) * (1.0f - t) + sf::Vector3f(-size, size, -size) * t; break;
-                    case 3: p.position = sf::Vector3f(-size, size, -size) * (1.0f - t) + sf::Vector3f(-size, -size, -size) * t; break;
-                    case 4: p.position = sf::Vector3f(-size, -size, size) * (1.0f - t) + sf::Vector3f(size, -size, size) * t; break;
-                    case 5: p.position = sf::Vector3f(size, -size, size) * (1.0f - t) + sf::Vector3f(size, size, size) * t; break;
-                    case 6: p.position = sf::Vector3f(size, size, size) * (1.0f - t) + sf::Vector3f(-size, size, size) * t; break;
-                    case 7: p.position = sf::Vector3f(-size, size, size) * (1.0f - t) + sf::Vector3f(-size, -size, size) * t; break;
-                    case 8: p.position = sf::Vector3f(-size, -size, -size) * (1.0f - t) + sf::Vector3f(-size, -size, size) * t; break;
-                    case 9: p.position = sf::Vector3f(size, -size, -size) * (1.0f - t) + sf::Vector3f(size, -size, size) * t; break;
-                    case 10: p.position = sf::Vector3f(size, size, -size) * (1.0f - t) + sf::Vector3f(size, size, size) * t; break;
-                    case 11: p.position = sf::Vector3f(-size, size, -size) * (1.0f - t) + sf::Vector3f(-size, size, size) * t; break;
-                }
-                p.originalPosition = p.position;
-                p.size = 2.0f + 0.5f * sin(t * PI * 4); // Variation size
-                p.velocity = sf::Vector3f(0, 0, 0);
-                float hue = (edge * 30.0f + hueOffset);
-                p.color = hslToColor(hue, 0.8f, 0.6f);
-                p.color.a = 220;
-                p.isOrbiting = false;
-                particles.push_back(p);
-            }
-        }
-        // Thêm hạt ở mặt để tạo khối (mờ hơn)
-        int faceParticles = 100; // Per face
-        for (int face = 0; face < 6; face++) {
-            for (int i = 0; i < faceParticles; i++) {
-                Particle3D p;
-                float u = (rand() % 1000) / 1000.0f;
-                float v = (rand() % 1000) / 1000.0f;
-                switch(face) {
-                    case 0: p.position = sf::Vector3f(size * (2*u-1), size * (2*v-1), -size); break; // Front
-                    case 1: p.position = sf::Vector3f(size * (2*u-1), size * (2*v-1), size); break; // Back
-                    case 2: p.position = sf::Vector3f(size * (2*u-1), -size, size * (2*v-1)); break; // Bottom
-                    case 3: p.position = sf::Vector3f(size * (2*u-1), size, size * (2*v-1)); break; // Top
-                    case 4: p.position = sf::Vector3f(-size, size * (2*u-1), size * (2*v-1)); break; // Left
-                    case 5: p.position = sf::Vector3f(size, size * (2*u-1), size * (2*v-1)); break; // Right
-                }
-                p.originalPosition = p.position;
-                p.size = 1.5f;
-                p.velocity = sf::Vector3f(0, 0, 0);
-                p.color = hslToColor(face * 60.0f + hueOffset, 0.7f, 0.5f);
-                p.color.a = 80; // Mờ để không che cạnh
-                p.isOrbiting = false;
-                particles.push_back(p);
-            }
-        }
-    }
-    // Hình số 8 xoắn 3D DẠNG KHỐI - Cải thiện: Tăng slices, thêm variation thickness, màu rainbow
-    void generateFigure8Spiral() {
-        particles.clear();
-        int numSlices = 15; // Tăng slices
-        int particlesPerSlice = 250;
-        for (int slice = 0; slice < numSlices; slice++) {
-            float zOffset = (slice - numSlices/2.0f) * 12.0f;
-            for (int i = 0; i < particlesPerSlice; i++) {
-                Particle3D p;
-                float t = static_cast<float>(i) / particlesPerSlice * 4.0f * PI;
-                float scale = shapeParams.figure8Scale * shapeScale;
-                float a = scale * sqrt(2.0f * cos(2.0f * t) + 0.1f * sin(t * 3)); // Variation a
-                float x = a * cos(t);
-                float y = a * sin(t);
-                float z = zOffset + scale * 0.15f * sin(t * 4.0f + time);
-                float thickness = 6.0f + 2.0f * sin(slice * PI / numSlices);
-                float offsetAngle = t * 3.0f + slice * 0.2f;
-                float offsetX = thickness * cos(offsetAngle);
-                float offsetY = thickness * sin(offsetAngle);
-                p.position = sf::Vector3f(x + offsetX, y + offsetY, z);
-                p.originalPosition = p.position;
-                p.size = 1.8f + 1.2f * sin(t * 6.0f + slice * 0.6f);
-                p.velocity = sf::Vector3f(0, 0, 0);
-                float hue = (t * 90.0f + slice * 20.0f + hueOffset);
-                p.color = hslToColor(hue, 0.95f, 0.65f);
-                p.color.a = 190 - slice * 8;
-                p.isOrbiting = false;
-                particles.push_back(p);
-            }
-        }
-        // Tăng connections
-        int connections = 500;
-        for (int i = 0; i < connections; i++) {
-            Particle3D p;
-            float t = (rand() % 1000) / 1000.0f * 4.0f * PI;
-            int slice1 = rand() % numSlices;
-            int slice2 = (slice1 + 1 + rand() % 3) % numSlices;
-            float scale = shapeParams.figure8Scale * shapeScale;
-            float a = scale * sqrt(2.0f * cos(2.0f * t));
-            float x = a * cos(t);
-            float y = a * sin(t);
-            float z1 = (slice1 - numSlices/2.0f) * 12.0f;
-            float z2 = (slice2 - numSlices/2.0f) * 12.0f;
-            float interp = (rand() % 1000) / 1000.0f;
-            float z = z1 * (1.0f - interp) + z2 * interp;
-            p.position = sf::Vector3f(x, y, z);
-            p.originalPosition = p.position;
-            p.size = 1.0f;
-            p.velocity = sf::Vector3f(0, 0, 0);
-            p.color = sf::Color(255, 255, 200, 60 + rand() % 40);
-            p.isOrbiting = false;
-            particles.push_back(p);
-        }
-    }
-    // Mô hình nguyên tử - Cải thiện: Thêm nhiều orbit hơn, variation nucleus, trails dài hơn
-    void generateAtomicModel() {
-        particles.clear();
-        // Hạt nhân
-        int nucleusParticles = 300; // Tăng
-        float nucleusSize = shapeParams.atomNucleusSize * shapeScale;
-        for (int i = 0; i < nucleusParticles; i++) {
-            Particle3D p;
-            float phi = acos(1.0f - 2.0f * (i + 0.5f) / nucleusParticles);
-            float theta = PI * (1.0f + sqrt(5.0f)) * i;
-            float r = nucleusSize * (0.6f + 0.4f * sin(time + theta * 2.0f));
-            p.position.x = r * sin(phi) * cos(theta);
-            p.position.y = r * sin(phi) * sin(theta);
-            p.position.z = r * cos(phi);
-            p.originalPosition = p.position;
-            p.size = 2.0f + 1.5f * sin(theta * 6.0f + time);
-            p.velocity = sf::Vector3f(0, 0, 0);
-            float hue = 0.0f + 30.0f * sin(theta);
-            p.color = hslToColor(hue, 0.9f, 0.6f);
-            p.color.a = 240;
-            p.isOrbiting = false;
-            particles.push_back(p);
-        }
-        // Orbits
-        int orbits = 4; // Tăng
-        int electronsPerOrbit = 10;
-        float orbitSpeeds[] = {1.2f, 0.8f, 0.5f, 0.3f};
-        float orbitRadii[] = {200.0f, 140.0f, 100.0f, 60.0f};
-        sf::Color orbitColors[] = {
-            sf::Color(80, 180, 255, 210),
-            sf::Color(80, 255, 180, 210),
-            sf::Color(255, 180, 80, 210),
-            sf::Color(180, 80, 255, 210)
-        };
-        for (int orbit = 0; orbit < orbits; orbit++) {
-            for (int i = 0; i < electronsPerOrbit; i++) {
-                Particle3D p;
-                float angle = static_cast<float>(i) / electronsPerOrbit * 2.0f * PI + time * orbitSpeeds[orbit];
-                float radius = orbitRadii[orbit] * shapeScale;
-                float tilt = orbit * 0.3f; // Tilt different orbits
-                float x = radius * cos(angle);
-                float y = radius * sin(angle) * cos(tilt);
-                float z = radius * sin(angle) * sin(tilt);
-                p.position = sf::Vector3f(x, y, z);
-                p.originalPosition = p.position;
-                p.size = 2.5f + 0.5f * orbit;
-                p.velocity = sf::Vector3f(0, 0, 0);
-                p.color = orbitColors[orbit];
-                p.isOrbiting = true;
-                p.orbitCenter = sf::Vector3f(0, 0, 0);
-                p.orbitRadius = radius;
-                p.orbitAngle = angle;
-                p.orbitSpeed = orbitSpeeds[orbit];
-                particles.push_back(p);
-            }
-        }
-    }
-    // Hình trái tim 3D DẠNG KHỐI - Cải thiện: Tăng layers, inner particles dày hơn, màu gradient mượt
-    void generateHeart3D() {
-        particles.clear();
-        int numLayers = 12; // Tăng
-        int particlesPerLayer = 400;
-        for (int layer = 0; layer < numLayers; layer++) {
-            float layerFactor = (layer - numLayers/2.0f) / (numLayers/2.0f);
-            for (int i = 0; i < particlesPerLayer; i++) {
-                Particle3D p;
-                float u = static_cast<float>(i) / particlesPerLayer * 2.0f * PI;
-                float scale = shapeParams.heartScale * shapeScale;
-                float x = 16.0f * pow(sin(u), 3);
-                float y = 13.0f * cos(u) - 5.0f * cos(2.0f * u) - 2.0f * cos(3.0f * u) - cos(4.0f * u);
-                float thickness = 8.0f * layerFactor * (0.7f + 0.3f * cos(layer * 3.0f));
-                p.position = sf::Vector3f(
-                    x * scale * 0.08f + 2.0f * sin(u * 5.0f),
-                    -y * scale * 0.08f + 2.0f * cos(u * 5.0f),
-                    thickness * (0.6f + 0.4f * sin(u * 3.0f))
-                );
-                p.originalPosition = p.position;
-                p.size = 1.8f + 1.0f * sin(u * 8.0f + layer * 0.5f);
-                p.velocity = sf::Vector3f(0, 0, 0);
-                float redIntensity = 0.6f + 0.4f * (1.0f - fabs(layerFactor));
-                float pinkFactor = fabs(layerFactor) * 0.6f;
-                float hue = 330.0f + 30.0f * layerFactor;
-                p.color = hslToColor(hue, 0.8f, redIntensity * 0.5f + pinkFactor * 0.5f);
-                p.color.a = 170 + 80 * (layer % 2);
-                p.isOrbiting = false;
-                particles.push_back(p);
-            }
-        }
-        // Inner particles dày hơn
-        int innerParticles = 800;
-        for (int i = 0; i < innerParticles; i++) {
-            Particle3D p;
-            float r = (rand() % 1000) / 1000.0f;
-            float theta = (rand() % 1000) / 1000.0f * 2.0f * PI;
-            float phi = (rand() % 1000) / 1000.0f * PI;
-            float scale = shapeParams.heartScale * shapeScale * 0.6f;
-            p.position.x = scale * r * sin(phi) * cos(theta) * 0.4f;
-            p.position.y = scale * r * sin(phi) * sin(theta) * 0.4f;
-            p.position.z = scale * r * cos(phi) * 0.25f;
-            float heartX = p.position.x / (scale * 0.08f);
-            float heartY = -p.position.y / (scale * 0.08f);
-            float heartVal = pow(heartX*heartX + heartY*heartY - 1, 3) - heartX*heartX * heartY*heartY*heartY;
-            if (heartVal < 0.15f) { // Mở rộng vùng
-                p.originalPosition = p.position;
-                p.size = 1.2f + 0.8f * sin(i * 0.05f);
-                p.velocity = sf::Vector3f(0, 0, 0);
-                p.color = hslToColor(340.0f + rand() % 20, 0.7f, 0.6f);
-                p.color.a = 100 + rand() % 40;
-                p.isOrbiting = false;
-                particles.push_back(p);
-            }
+    void generateCurrentShape() {
+        // Khi bật bức tường chỉ cloud dùng chung trong cache được vẽ, bỏ luôn bản sao của hình đơn
+        if (sceneMode) PointCloud().swap(particles);
+        else generateShape(currentShape, particles, shapeParams, shapeScale, hueOffset, time);
+        dynamicIndices.clear();
+        for (size_t i = 0; i < particles.size(); i++) {
+            if (particles[i].isOrbiting) dynamicIndices.push_back(static_cast<int>(i));
         }
+        particlesVersion++;
+        selected.assign(particles.size(), 0);
+        selectedCount = 0;
+        hoveredIndex = -1;
+        // Kết quả chiếu cũ không còn khớp chỉ số với particles mới
+        pickGrid.clear();
+        dynamicProjected.clear();
+        if (sceneMode) buildScene();
     }
-    // Xoắn kép (DNA-like) - Cải thiện: Thêm bonds giữa strands, variation radius, màu gradient
-    void generateDoubleHelix() {
-        particles.clear();
-        int numParticles = 1200; // Tăng
-        float radius = shapeParams.helixRadius * shapeScale;
-        float height = 350.0f * shapeScale;
-        for (int i = 0; i < numParticles; i++) {
-            float t = static_cast<float>(i) / numParticles;
-            float z = height * (t - 0.5f);
-            for (int strand = 0; strand < 2; strand++) {
-                Particle3D p;
-                float angle = t * 10.0f * PI + (strand * PI) + sin(t * PI) * 0.5f; // Variation angle
-                float localRadius = radius * (0.8f + 0.2f * sin(t * 6.0f * PI));
-                float x = localRadius * cos(angle);
-                float y = localRadius * sin(angle);
-                p.position = sf::Vector3f(x, y, z);
-                p.originalPosition = p.position;
-                p.size = 2.5f + 0.5f * cos(t * PI * 10);
-                p.velocity = sf::Vector3f(0, 0, 0);
-                float hue = (strand == 0 ? 0.0f : 240.0f) + t * 60.0f + hueOffset;
-                p.color = hslToColor(hue, 0.9f, 0.7f);
-                p.color.a = 230;
-                p.isOrbiting = false;
-                particles.push_back(p);
-            }
-        }
-        // Thêm bonds giữa strands
-        int bonds = numParticles / 2;
-        for (int i = 0; i < bonds; i++) {
-            float t = static_cast<float>(i) / bonds;
-            float z = height * (t - 0.5f);
-            float angle = t * 10.0f * PI;
-            sf::Vector3f pos1(radius * cos(angle), radius * sin(angle), z);
-            sf::Vector3f pos2 = pos1 * -1.0f; // Opposite
-            int numBondParticles = 10;
-            for (int j = 0; j < numBondParticles; j++) {
-                Particle3D p;
-                float interp = static_cast<float>(j) / (numBondParticles - 1);
-                p.position = pos1 * (1.0f - interp) + pos2 * interp;
-                p.originalPosition = p.position;
-                p.size = 1.5f;
-                p.velocity = sf::Vector3f(0, 0, 0);
-                p.color = sf::Color(200, 200, 200, 150);
-                p.isOrbiting = false;
-                particles.push_back(p);
+    // Bức tường các bản thể của hình hiện tại: tất cả trỏ tới cùng một cloud trong cache,
+    // mỗi bản thể chỉ giữ transform, tint và pha quay riêng
+    void buildScene() {
+        static const int sceneColumns[] = {4, 6, 8, 12};
+        static const int sceneRows[] = {3, 4, 6, 8};
+        int columns = sceneColumns[sceneSizeIndex];
+        int rows = sceneRows[sceneSizeIndex];
+        float spacingX = 120.0f, spacingY = 130.0f;
+        float instanceScale = 0.35f * 4.0f / columns;
+        sceneInstances.clear(); // Thả tham chiếu tới cloud cũ trước khi cache sinh cloud mới
+        PointCloudPtr cloud = cloudCache.get(currentShape, shapeParams, shapeScale, hueOffset, time);
+        for (int row = 0; row < rows; row++) {
+            for (int col = 0; col < columns; col++) {
+                ShapeInstance instance;
+                instance.cloud = cloud;
+                instance.offset = sf::Vector3f(
+                    (col - (columns - 1) / 2.0f) * spacingX * 4.0f / columns,
+                    (row - (rows - 1) / 2.0f) * spacingY * 4.0f / columns,
+                    0.0f);
+                instance.scale = instanceScale;
+                instance.spinSpeed = 0.6f + 0.15f * ((row + col) % 4);
+                instance.phase = (row * columns + col) * 0.7f;
+                instance.tint = hslToColor(hueOffset + (row * columns + col) * 360.0f / (rows * columns), 0.5f, 0.75f);
+                instance.tint.a = 255;
+                sceneInstances.push_back(instance);
             }
         }
     }
-    void generateCurrentShape() {
-        switch(currentShape) {
-            case SPHERE_3D: generateSphere3D(); break;
-            case HOLLOW_CUBE: generateHollowCube(); break;
-            case FIGURE8_SPIRAL: generateFigure8Spiral(); break;
-            case ATOMIC_MODEL: generateAtomicModel(); break;
-            case HEART_3D: generateHeart3D(); break;
-            case DOUBLE_HELIX: generateDoubleHelix(); break;
-        }
+    Camera camera() const {
+        Camera cam;
+        cam.distance = cameraDistance;
+        cam.angleX = cameraAngleX;
+        cam.angleY = cameraAngleY;
+        cam.angleZ = cameraAngleZ;
+        cam.shapeScale = shapeScale;
+        return cam;
     }
-    sf::Color hslToColor(float h, float s, float l) {
-        h = fmod(h, 360.0f);
-        float c = (1.0f - fabs(2.0f * l - 1.0f)) * s;
-        float x = c * (1.0f - fabs(fmod(h / 60.0f, 2.0f) - 1.0f));
-        float m = l - c / 2.0f;
-        float r, g, b;
-        if (h < 60) { r = c; g = x; b = 0; }
-        else if (h < 120) { r = x; g = c; b = 0; }
-        else if (h < 180) { r = 0; g = c; b = x; }
-        else if (h < 240) { r = 0; g = x; b = c; }
-        else if (h < 300) { r = x; g = 0; b = c; }
-        else { r = c; g = 0; b = x; }
-        return sf::Color(
-            static_cast<sf::Uint8>((r + m) * 255),
-            static_cast<sf::Uint8>((g + m) * 255),
-            static_cast<sf::Uint8>((b + m) * 255),
-            220
-        );
+    Distortion distortion() const {
+        Distortion d;
+        d.amount = distortionAmount;
+        d.axis = distortionAxis;
+        return d;
     }
     void update(float deltaTime) {
         time += deltaTime;
@@ -506,75 +246,35 @@ public:
         if (colorCycleEnabled) {
             hueOffset += deltaTime * 30.0f;
         }
-        if (currentShape == ATOMIC_MODEL) {
-            for (auto& p : particles) {
-                if (p.isOrbiting) {
-                    p.orbitAngle += deltaTime * p.orbitSpeed;
-                    float tilt = (p.orbitRadius / 60.0f - 1.0f) * 0.3f; // Dựa vào radius
-                    float x = p.orbitRadius * cos(p.orbitAngle);
-                    float y = p.orbitRadius * sin(p.orbitAngle) * cos(tilt);
-                    float z = p.orbitRadius * sin(p.orbitAngle) * sin(tilt);
-                    p.position = sf::Vector3f(x, y, z);
-                    // Trails
-                    TrailPoint trail;
-                    trail.position = p.position;
-                    trail.color = p.color;
-                    trail.color.a = 120;
-                    trail.lifetime = 0.8f; // Dài hơn
-                    trails.push_back(trail);
-                }
-            }
+        // Trail electron được lấy mẫu theo trailSampling của mức chất lượng hiện tại
+        electronTrailAccumulator += quality.trailSampling;
+        bool emitElectronTrails = electronTrailAccumulator >= 1.0f;
+        if (emitElectronTrails) electronTrailAccumulator -= 1.0f;
+        updateTrails(trails, deltaTime);
+        infoTextTimer += deltaTime;
+        if (infoTextTimer >= 0.25f) {
+            infoTextTimer = 0.0f;
+            updateInfoText();
         }
-        for (auto& trail : trails) {
-            trail.lifetime -= deltaTime;
+        // Scene dùng cloud bất biến nên không mô phỏng particles của hình đơn
+        if (sceneMode) return;
+        if (currentShape == ATOMIC_MODEL) {
+            updateElectrons(particles, trails, emitElectronTrails, quality.trailLength, deltaTime);
         }
-        trails.erase(std::remove_if(trails.begin(), trails.end(),
-            [](const TrailPoint& t) { return t.lifetime <= 0.0f; }),
-            trails.end());
-        if (particles.size() > 100) {
-            int trailSamples = std::min(10, static_cast<int>(particles.size() / 100));
-            for (int i = 0; i < trailSamples; i++) {
-                int idx = rand() % particles.size();
-                const auto& p = particles[idx];
-                float speed = sqrt(p.velocity.x*p.velocity.x + p.velocity.y*p.velocity.y + p.velocity.z*p.velocity.z);
-                if (speed > 0.1f) {
-                    TrailPoint trail;
-                    trail.position = p.position;
-                    trail.color = p.color;
-                    trail.color.a = 60;
-                    trail.lifetime = 0.4f;
-                    trails.push_back(trail);
-                }
-            }
+        sampleVelocityTrails(particles, trails, quality.trailSampling, quality.trailLength);
+        if (dynamicsEnabled) {
+            // Distortion được áp vào vị trí đích của lực kéo thay vì ghi đè position
+            dynamics.step(particles, camera(), distortion(),
+                sf::Mouse::isButtonPressed(sf::Mouse::Right),
+                static_cast<sf::Vector2f>(sf::Mouse::getPosition(window)), time, deltaTime);
+            particlesVersion++;
         }
-        // Cải thiện distortion: Làm mượt hơn, thêm multi-axis
-        if (fabs(distortionAmount) > 0.001f) {
-            for (auto& p : particles) {
-                sf::Vector3f toCenter = p.originalPosition;
-                float distance = sqrt(toCenter.x*toCenter.x + toCenter.y*toCenter.y + toCenter.z*toCenter.z);
-                if (distance > 0.1f) {
-                    float wave = sin(distance * 0.05f + time * 2.0f) * distortionAmount;
-                    float twist = cos(distance * 0.03f + time) * distortionAmount * 0.5f;
-                    p.position = p.originalPosition + distortionAxis * wave;
-                    // Thêm twist
-                    float tempX = p.position.x * cos(twist) - p.position.y * sin(twist);
-                    float tempY = p.position.x * sin(twist) + p.position.y * cos(twist);
-                    p.position.x = tempX;
-                    p.position.y = tempY;
-                }
-            }
+        else if (fabs(distortionAmount) > 0.001f) {
+            distortParticles(particles, distortion(), time);
+            particlesVersion++;
         }
-        updateInfoText();
     }
     void updateInfoText() {
-        std::string shapeNames[TOTAL_SHAPES] = {
-            "3D Hollow Sphere",
-            "Hollow Cube",
-            "3D Figure-8 Spiral",
-            "Atomic Model",
-            "3D Heart",
-            "Double Helix"
-        };
         std::stringstream info;
         info << "CONTROLS:\n";
         info << "• T or Transform Button: Transform Shape\n";
@@ -586,30 +286,30 @@ public:
         info << "• C: Toggle Color Cycle " << (colorCycleEnabled ? "[ON]" : "[OFF]") << "\n";
         info << "• Space: Toggle Auto-Rotate " << (autoRotate ? "[ON]" : "[OFF]") << "\n";
         info << "• +/-: Adjust Particle Size\n";
+        info << "• P: Toggle Dynamics " << (dynamicsEnabled ? "[ON]" : "[OFF]") << "\n";
+        info << "• Right Drag: Repel Particles (Dynamics)\n";
+        info << "• Q: Lock Quality " << (governor.locked ? "[LOCKED]" : "[AUTO]") << "\n";
+        info << "• [ / ]: Lower/Raise Quality (locks)\n";
+        info << "• I: Toggle Instanced Wall " << (sceneMode ? "[ON]" : "[OFF]") << "\n";
+        info << "• O: Cycle Wall Size\n";
+        info << "• Click: Select Particle, Ctrl + Drag: Box Select\n";
         info << "• ESC: Exit\n\n";
         info << "Camera Distance: " << static_cast<int>(cameraDistance) << "\n";
         info << "Rotation: " << (autoRotate ? "Auto" : "Manual") << "\n";
+        if (sceneMode && !sceneInstances.empty()) {
+            info << "Scene: " << sceneInstances.size() << " x " << shapeName(currentShape)
+                 << " (" << sceneInstances[0].cloud->size() << " shared particles)\n";
+        }
+        if (selectedCount > 0) {
+            info << "Selected: " << selectedCount << " particles\n";
+        }
+        info << "Quality: " << governor.level << "/" << (QualityGovernor::LEVELS - 1)
+             << (governor.locked ? " [LOCKED]" : " [AUTO]") << "\n";
+        info.precision(1);
+        info << std::fixed << "Update: " << lastUpdateTime * 1000.0f << " ms, Render: "
+             << lastRenderTime * 1000.0f << " ms\n";
         infoText.setString(info.str());
     }
-    sf::Vector3f rotatePoint(sf::Vector3f point) {
-        point *= shapeScale;
-        float y1 = point.y * cos(cameraAngleX) - point.z * sin(cameraAngleX);
-        float z1 = point.y * sin(cameraAngleX) + point.z * cos(cameraAngleX);
-        float x2 = point.x * cos(cameraAngleY) + z1 * sin(cameraAngleY);
-        float z2 = -point.x * sin(cameraAngleY) + z1 * cos(cameraAngleY);
-        float x3 = x2 * cos(cameraAngleZ) - y1 * sin(cameraAngleZ);
-        float y3 = x2 * sin(cameraAngleZ) + y1 * cos(cameraAngleZ);
-        return sf::Vector3f(x3, y3, z2);
-    }
-    sf::Vector2f projectPoint(sf::Vector3f point) {
-        float fov = 400.0f; // Fixed fov, cameraDistance affects position
-        float z = point.z + cameraDistance;
-        if (z < 0.1f) z = 0.1f;
-        float scale = fov / z;
-        float x = point.x * scale + WIDTH / 2.0f;
-        float y = point.y * scale + HEIGHT / 2.0f;
-        return sf::Vector2f(x, y);
-    }
     void handleEvents() {
         sf::Event event;
         while (window.pollEvent(event)) {
@@ -639,11 +339,38 @@ public:
                     float my = static_cast<float>(event.mouseButton.y);
                     // Check if click on transform button
                     sf::FloatRect buttonBounds = transformButton.getGlobalBounds();
+                    clickSelectArmed = false;
                     if (buttonBounds.contains(mx, my)) {
                         transformShape();
                     } else {
                         lastMousePos = sf::Vector2f(mx, my);
+                        pressPos = lastMousePos;
+                        // Shift + kéo là thao tác distort, không được đổi vùng chọn
+                        clickSelectArmed = !sf::Keyboard::isKeyPressed(sf::Keyboard::LShift);
+                        if (!sceneMode && sf::Keyboard::isKeyPressed(sf::Keyboard::LControl)) {
+                            isBoxSelecting = true;
+                            boxStart = boxEnd = lastMousePos;
+                        }
+                    }
+                }
+            }
+            else if (event.type == sf::Event::MouseButtonReleased) {
+                if (event.mouseButton.button == sf::Mouse::Left) {
+                    sf::Vector2f releasePos(
+                        static_cast<float>(event.mouseButton.x),
+                        static_cast<float>(event.mouseButton.y)
+                    );
+                    sf::Vector2f moved = releasePos - pressPos;
+                    if (isBoxSelecting) {
+                        selectInBox(boxStart, releasePos);
+                        isBoxSelecting = false;
+                    } else if (clickSelectArmed && moved.x*moved.x + moved.y*moved.y < 9.0f &&
+                               !sf::Keyboard::isKeyPressed(sf::Keyboard::LShift) &&
+                               !transformButton.getGlobalBounds().contains(releasePos.x, releasePos.y)) {
+                        // Click không kéo: chọn hạt gần nhất (click vào chỗ trống thì bỏ chọn)
+                        selectNearest(releasePos);
                     }
+                    clickSelectArmed = false;
                 }
             }
             else if (event.type == sf::Event::MouseMoved) {
@@ -653,7 +380,9 @@ public:
                         static_cast<float>(event.mouseMove.y)
                     );
                     sf::Vector2f delta = currentPos - lastMousePos;
-                    if (sf::Keyboard::isKeyPressed(sf::Keyboard::LShift)) {
+                    if (isBoxSelecting) {
+                        boxEnd = currentPos;
+                    } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::LShift)) {
                         // Distort
                         distortionAmount += delta.x * 0.005f;
                         distortionAxis.x += delta.y * 0.002f;
@@ -671,6 +400,82 @@ public:
             }
         }
     }
+    // Hạt (chỉ số trong particles) gần point nhất: tra lưới bin cho lớp tĩnh, duyệt thẳng tập electron nhỏ
+    int pickParticle(sf::Vector2f point) const {
+        const float maxDistance = 12.0f;
+        float bestDist2 = maxDistance * maxDistance;
+        int best = -1;
+        int staticBest = pickGrid.nearest(point, maxDistance, projected);
+        if (staticBest >= 0) {
+            sf::Vector2f d = projected[staticBest].screen - point;
+            bestDist2 = d.x*d.x + d.y*d.y;
+            best = staticBest;
+        }
+        for (size_t k = 0; k < dynamicProjected.size(); k++) {
+            if (!dynamicProjected[k].visible) continue;
+            sf::Vector2f d = dynamicProjected[k].screen - point;
+            float dist2 = d.x*d.x + d.y*d.y;
+            if (dist2 < bestDist2) {
+                bestDist2 = dist2;
+                best = dynamicIndices[k];
+            }
+        }
+        return best;
+    }
+    void clearSelection() {
+        if (selectedCount == 0) return;
+        std::fill(selected.begin(), selected.end(), 0);
+        selectedCount = 0;
+        selectionVersion++;
+    }
+    void selectNearest(sf::Vector2f point) {
+        if (sceneMode) return;
+        clearSelection();
+        int index = pickParticle(point);
+        if (index >= 0) {
+            selected[index] = 1;
+            selectedCount = 1;
+            selectionVersion++;
+        }
+        infoTextTimer = 1.0f;
+    }
+    void selectInBox(sf::Vector2f a, sf::Vector2f b) {
+        clearSelection();
+        sf::FloatRect box(std::min(a.x, b.x), std::min(a.y, b.y), fabs(a.x - b.x), fabs(a.y - b.y));
+        std::vector<int> hits;
+        pickGrid.selectBox(box, projected, hits);
+        for (size_t k = 0; k < dynamicProjected.size(); k++) {
+            const ProjectedParticle& p = dynamicProjected[k];
+            if (p.visible && p.screen.x >= box.left && p.screen.x <= box.left + box.width &&
+                p.screen.y >= box.top && p.screen.y <= box.top + box.height) {
+                hits.push_back(dynamicIndices[k]);
+            }
+        }
+        for (int index : hits) {
+            selected[index] = 1;
+        }
+        selectedCount = static_cast<int>(hits.size());
+        selectionVersion++;
+        infoTextTimer = 1.0f;
+    }
+    void updateHover() {
+        hoveredIndex = -1;
+        if (sceneMode || isBoxSelecting || sf::Mouse::isButtonPressed(sf::Mouse::Left)) return;
+        sf::Vector2f mouse = static_cast<sf::Vector2f>(sf::Mouse::getPosition(window));
+        hoveredIndex = pickParticle(mouse);
+        if (hoveredIndex < 0) return;
+        const Particle3D& p = particles[hoveredIndex];
+        std::stringstream info;
+        info.precision(1);
+        info << std::fixed;
+        info << shapeName(currentShape) << " - " << describeLayer(currentShape, p.layer) << "\n";
+        info << "Color: (" << static_cast<int>(p.color.r) << ", " << static_cast<int>(p.color.g) << ", "
+             << static_cast<int>(p.color.b) << ", " << static_cast<int>(p.color.a) << ")\n";
+        info << "Position: (" << p.position.x << ", " << p.position.y << ", " << p.position.z << ")\n";
+        info << "Size: " << p.size << (p.isOrbiting ? ", orbiting" : "") << "\n";
+        hoverText.setString(info.str());
+        hoverText.setPosition(std::min(mouse.x + 16.0f, WIDTH - 260.0f), std::min(mouse.y + 16.0f, HEIGHT - 80.0f));
+    }
     void transformShape() {
         currentShape = static_cast<ShapeType>((currentShape + 1) % TOTAL_SHAPES);
         isTransitioning = true;
@@ -711,62 +516,132 @@ public:
             case sf::Keyboard::C:
                 colorCycleEnabled = !colorCycleEnabled;
                 break;
+            case sf::Keyboard::Q:
+                governor.locked = !governor.locked;
+                break;
+            case sf::Keyboard::LBracket:
+                governor.locked = true;
+                governor.setLevel(governor.level - 1);
+                quality = governor.settings(); // Đồng bộ ngay để static layer dựng lại đúng mức mới
+                break;
+            case sf::Keyboard::RBracket:
+                governor.locked = true;
+                governor.setLevel(governor.level + 1);
+                quality = governor.settings(); // Đồng bộ ngay để static layer dựng lại đúng mức mới
+                break;
+            case sf::Keyboard::I:
+                sceneMode = !sceneMode;
+                isBoxSelecting = false;
+                hoveredIndex = -1;
+                if (!sceneMode) {
+                    sceneInstances.clear();
+                    cloudCache.clear();
+                }
+                generateCurrentShape();
+                break;
+            case sf::Keyboard::O:
+                sceneSizeIndex = (sceneSizeIndex + 1) % 4;
+                if (sceneMode) buildScene();
+                break;
+            case sf::Keyboard::P:
+                dynamicsEnabled = !dynamicsEnabled;
+                if (!dynamicsEnabled) {
+                    dynamics.reset(particles);
+                    particlesVersion++;
+                }
+                break;
             case sf::Keyboard::Add:
             case sf::Keyboard::Equal:
                 for (auto& p : particles) {
                     p.size = std::min(10.0f, p.size + 0.1f);
                 }
+                particlesVersion++;
                 break;
             case sf::Keyboard::Subtract:
             case sf::Keyboard::Dash:
                 for (auto& p : particles) {
                     p.size = std::max(1.0f, p.size - 0.1f);
                 }
+                particlesVersion++;
                 break;
         }
+        infoTextTimer = 1.0f; // Cập nhật text ngay frame sau
     }
-    void render() {
-        window.clear(sf::Color(5, 10, 20));
-        trailRender.clear();
-        for (const auto& trail : trails) {
-            if (trail.lifetime > 0.0f) {
-                sf::Vector3f rotated = rotatePoint(trail.position);
-                sf::Vector2f projected = projectPoint(rotated);
-                float depth = rotated.z + cameraDistance;
-                if (depth > 0 && depth < 2000.0f) {
-                    sf::VertexArray trailVerts(sf::Points);
-                    sf::Vertex vertex(projected);
-                    sf::Color trailColor = trail.color;
-                    trailColor.a = static_cast<sf::Uint8>(trail.color.a * (trail.lifetime / 0.8f));
-                    vertex.color = trailColor;
-                    trailVerts.append(vertex);
-                    trailRender.push_back(trailVerts);
-                }
+    StaticLayerInputs currentStaticInputs() const {
+        StaticLayerInputs inputs;
+        inputs.cameraDistance = cameraDistance;
+        inputs.cameraAngleX = cameraAngleX;
+        inputs.cameraAngleY = cameraAngleY;
+        inputs.cameraAngleZ = cameraAngleZ;
+        inputs.shapeScale = shapeScale;
+        inputs.particlesVersion = particlesVersion;
+        inputs.qualityLevel = governor.level;
+        inputs.selectionVersion = selectionVersion;
+        return inputs;
+    }
+    // Chiếu + dựng vertex cho mọi hạt không quay quỹ đạo, rồi vẽ sẵn vào staticLayer
+    // Khi chỉ vùng chọn đổi (reproject = false) thì giữ nguyên kết quả chiếu và lưới picking
+    void rebuildStaticLayer(const Camera& cam, bool reproject) {
+        if (reproject) {
+            projectParticles(particles, cam, quality.visibleFraction, projected);
+            for (int i : dynamicIndices) {
+                projected[i].visible = false;
             }
+            pickGrid.build(projected);
         }
-        for (const auto& trail : trailRender) {
-            window.draw(trail);
+        buildParticleVertices(projected, quality, pointRender, triangleRender, &selected);
+        if (staticTextureAvailable) {
+            staticLayer.clear(sf::Color(5, 10, 20));
+            staticLayer.draw(pointRender);
+            staticLayer.draw(triangleRender);
+            staticLayer.display();
         }
-        for (const auto& p : particles) {
-            sf::Vector3f rotated = rotatePoint(p.position);
-            sf::Vector2f projected = projectPoint(rotated);
-            float depth = rotated.z + cameraDistance;
-            if (depth > 0 && depth < 2000.0f) {
-                float projScale = 400.0f / depth; // Scale size with distance for perspective
-                float size = p.size * projScale;
-                size = std::max(0.5f, std::min(10.0f, size));
-                sf::CircleShape particle(size);
-                particle.setPosition(projected.x - size, projected.y - size);
-                sf::Color depthColor = p.color;
-                float depthFactor = 1.0f - (depth / 2000.0f); // Adjusted for farther fade
-                depthColor.a = static_cast<sf::Uint8>(p.color.a * (0.4f + 0.6f * depthFactor));
-                particle.setFillColor(depthColor);
-                sf::Color glowColor = depthColor;
-                glowColor.a = 60;
-                particle.setOutlineColor(glowColor);
-                particle.setOutlineThickness(1.5f);
-                window.draw(particle);
+    }
+    void render() {
+        Camera cam = camera();
+        if (sceneMode) {
+            // Các bản thể luôn quay nên không có gì để cache
+            staticLayerValid = false;
+            window.clear(sf::Color(5, 10, 20));
+            // Xử lý instance theo lô để bộ đệm chiếu chỉ lớn cỡ vài cloud, không phải cả scene
+            const size_t instanceBatch = 8;
+            for (size_t first = 0; first < sceneInstances.size(); first += instanceBatch) {
+                projectInstances(sceneInstances, first, instanceBatch, cam, quality.visibleFraction, time, projected);
+                buildParticleVertices(projected, quality, pointRender, triangleRender);
+                window.draw(pointRender);
+                window.draw(triangleRender);
+            }
+        } else {
+            StaticLayerInputs inputs = currentStaticInputs();
+            bool reproject = !staticLayerValid || !inputs.sameProjection(staticInputs);
+            if (reproject || inputs.selectionVersion != staticInputs.selectionVersion) {
+                rebuildStaticLayer(cam, reproject);
+                staticInputs = inputs;
+                staticLayerValid = true;
+            }
+            if (staticTextureAvailable) {
+                window.draw(sf::Sprite(staticLayer.getTexture()));
+            } else {
+                window.clear(sf::Color(5, 10, 20));
+                window.draw(pointRender);
+                window.draw(triangleRender);
+            }
+            // Tập động: electron
+            if (!dynamicIndices.empty()) {
+                projectParticleSubset(particles, dynamicIndices, cam, quality.visibleFraction, dynamicProjected);
+                dynamicHighlight.resize(dynamicIndices.size());
+                for (size_t k = 0; k < dynamicIndices.size(); k++) {
+                    dynamicHighlight[k] = selected[dynamicIndices[k]];
+                }
+                buildParticleVertices(dynamicProjected, quality, dynamicPointRender, dynamicTriangleRender, &dynamicHighlight);
+                window.draw(dynamicPointRender);
+                window.draw(dynamicTriangleRender);
             }
+            updateHover();
+        }
+        if (!trails.empty()) {
+            buildTrailVertices(trails, cam, quality.trailLength, trailRender);
+            window.draw(trailRender);
         }
         if (isTransitioning) {
             float alpha = sin(shapeTransition * PI) * 100.0f;
@@ -774,18 +649,47 @@ public:
             transition.setFillColor(sf::Color(255, 255, 255, static_cast<sf::Uint8>(alpha)));
             window.draw(transition);
         }
+        if (hoveredIndex >= 0) {
+            // Vòng đánh dấu quanh hạt đang hover
+            sf::Vector3f rotated = rotatePoint(particles[hoveredIndex].position, cam);
+            sf::Vector2f screen = projectPoint(rotated, cam);
+            sf::CircleShape marker(8.0f);
+            marker.setPosition(screen.x - 8.0f, screen.y - 8.0f);
+            marker.setFillColor(sf::Color::Transparent);
+            marker.setOutlineColor(sf::Color(255, 255, 160, 200));
+            marker.setOutlineThickness(1.5f);
+            window.draw(marker);
+        }
+        if (isBoxSelecting) {
+            sf::RectangleShape box(sf::Vector2f(fabs(boxEnd.x - boxStart.x), fabs(boxEnd.y - boxStart.y)));
+            box.setPosition(std::min(boxStart.x, boxEnd.x), std::min(boxStart.y, boxEnd.y));
+            box.setFillColor(sf::Color(255, 255, 160, 30));
+            box.setOutlineColor(sf::Color(255, 255, 160, 180));
+            box.setOutlineThickness(1.0f);
+            window.draw(box);
+        }
         window.draw(infoText);
         window.draw(transformButton);
         window.draw(transformButtonText);
-        window.display();
+        if (hoveredIndex >= 0) {
+            window.draw(hoverText);
+        }
     }
     void run() {
         sf::Clock frameClock;
+        sf::Clock stageClock;
         while (window.isOpen()) {
             float deltaTime = frameClock.restart().asSeconds();
             handleEvents();
+            stageClock.restart();
             update(deltaTime);
+            lastUpdateTime = stageClock.restart().asSeconds();
             render();
+            lastRenderTime = stageClock.restart().asSeconds();
+            // Không tính display() vì nó chờ framerate limit
+            window.display();
+            governor.record(lastUpdateTime + lastRenderTime, deltaTime);
+            quality = governor.settings();
         }
     }
 };